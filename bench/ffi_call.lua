@@ -0,0 +1,55 @@
+-- call tiny C functions through the FFI from the interpreter
+-- stresses argument conversion and result handling in lj_ccall_func
+-- usage: luajit ffi_call.lua [calls]
+
+local ffi = require("ffi")
+
+ffi.cdef[[
+int abs(int);
+double sqrt(double);
+size_t strlen(const char *);
+void *memchr(const void *, int, size_t);
+double ldexp(double, int);
+]]
+
+local C = ffi.C
+local n = tonumber(arg and arg[1]) or 1000000
+local buf = ffi.new("char[16]", "hello, world")
+local s = "hello, world"
+
+jit.off()
+
+local t0 = os.clock()
+local sum = 0
+for i = 1, n do sum = sum + C.abs(-i) end
+local dt = os.clock() - t0
+assert(sum == n*(n+1)/2, "bad result")
+print(string.format("abs(int)            %8.3fs  %6.1f ns/call", dt, dt*1e9/n))
+
+t0 = os.clock()
+sum = 0
+for i = 1, n do sum = sum + C.sqrt(4) end
+dt = os.clock() - t0
+assert(sum == 2*n, "bad result")
+print(string.format("sqrt(double)        %8.3fs  %6.1f ns/call", dt, dt*1e9/n))
+
+t0 = os.clock()
+sum = 0
+for i = 1, n do sum = sum + tonumber(C.strlen(s)) end
+dt = os.clock() - t0
+assert(sum == 12*n, "bad result")
+print(string.format("strlen(string)      %8.3fs  %6.1f ns/call", dt, dt*1e9/n))
+
+t0 = os.clock()
+sum = 0
+for i = 1, n do if C.memchr(buf, 111, 12) ~= nil then sum = sum + 1 end end
+dt = os.clock() - t0
+assert(sum == n, "bad result")
+print(string.format("memchr(ptr,int,int) %8.3fs  %6.1f ns/call", dt, dt*1e9/n))
+
+t0 = os.clock()
+sum = 0
+for i = 1, n do sum = sum + C.ldexp(0.5, 1) end
+dt = os.clock() - t0
+assert(sum == n, "bad result")
+print(string.format("ldexp(double,int)   %8.3fs  %6.1f ns/call", dt, dt*1e9/n))
@@ -0,0 +1,36 @@
+-- parse one large generated header with ffi.cdef, then resolve its names
+-- stresses C type interning and name lookups in the C type hash table
+-- usage: luajit ffi_cdef.lua [declarations]
+
+local ffi = require("ffi")
+
+-- There are at most 65536 C type IDs, including the predefined ones.
+-- Four declarations use five IDs, so n must stay below about 52000.
+local n = tonumber(arg and arg[1]) or 50000
+
+local buf = {}
+for i = 0, n/4-1 do
+  buf[#buf+1] = string.format([[
+typedef int t%d;
+extern t%d v%d;
+static const t%d K%d = %d;
+t%d f%d(t%d);
+]], i, i, i, i, i, i, i, i, i)
+end
+local hdr = table.concat(buf)
+
+local t0 = os.clock()
+ffi.cdef(hdr)
+local dt = os.clock() - t0
+print(string.format("cdef    %8d declarations %8.3fs  %6.1f us/declaration",
+		    n, dt, dt * 1e6 / n))
+
+t0 = os.clock()
+local sum = 0
+for i = 0, n/4-1 do
+  sum = sum + ffi.sizeof("t"..i) + ffi.C["K"..i]
+end
+dt = os.clock() - t0
+assert(sum == (n/4)*(n/4-1)/2 + 4*(n/4), "bad lookup")
+print(string.format("lookup  %8d names        %8.3fs  %6.1f us/name",
+		    2*(n/4), dt, dt * 1e6 / (2*(n/4))))
@@ -0,0 +1,44 @@
+-- call a Lua comparator from C qsort() through an FFI callback
+-- every comparison crosses the C -> Lua callback boundary twice
+-- usage: luajit ffi_qsort.lua [elements]
+
+local ffi = require("ffi")
+
+ffi.cdef[[
+void qsort(void *base, size_t nmemb, size_t size,
+	   int (*compar)(const void *, const void *));
+]]
+
+local n = tonumber(arg and arg[1]) or 1e7
+
+local function fill(a, seed)
+  for i = 0, n-1 do
+    seed = (seed * 1103515245 + 12345) % 2147483648
+    a[i] = seed
+  end
+end
+
+local function run(name, ct, cmp)
+  local a = ffi.new(ct .. "[?]", n)
+  fill(a, 42)
+  local cb = ffi.cast("int (*)(const void *, const void *)", cmp)
+  local t0 = os.clock()
+  ffi.C.qsort(a, n, ffi.sizeof(ct), cb)
+  local dt = os.clock() - t0
+  cb:free()
+  for i = 1, n-1 do assert(a[i-1] <= a[i], "not sorted") end
+  print(string.format("%-7s %10d elements %8.3fs  %6.1f ns/element", name, n,
+		      dt, dt * 1e9 / n))
+end
+
+local pint = ffi.typeof("const int32_t *")
+run("int32", "int32_t", function(x, y)
+  local a, b = ffi.cast(pint, x)[0], ffi.cast(pint, y)[0]
+  return a < b and -1 or (a > b and 1 or 0)
+end)
+
+local pdbl = ffi.typeof("const double *")
+run("double", "double", function(x, y)
+  local a, b = ffi.cast(pdbl, x)[0], ffi.cast(pdbl, y)[0]
+  return a < b and -1 or (a > b and 1 or 0)
+end)
@@ -0,0 +1,50 @@
+-- compare the register eviction heuristics of the trace assembler
+-- the kernel updates a few accumulators from many loop invariant
+-- coefficients in a fixed pseudo-random order, so the assembler has to
+-- evict live values and the choice of victim affects the spill count
+-- (fewer spills rarely show up in the time on out-of-order CPUs)
+-- usage: luajit regalloc.lua [iterations] [seed]
+
+local n = tonumber(arg and arg[1]) or 1e7
+local seed = tonumber(arg and arg[2]) or 1
+local jutil = require("jit.util")
+
+local nk, nv, nstmt = 30, 8, 40
+local src = { "local n = ...", "local k = {}",
+	      "for i = 1, " .. nk .. " do k[i] = 1 + i * 1e-3 end" }
+for i = 1, nk do src[#src+1] = ("local k%d = k[%d]"):format(i, i) end
+for i = 1, nv do src[#src+1] = ("local v%d = %d.5"):format(i, i) end
+src[#src+1] = "for i = 1, n do"
+src[#src+1] = "  local x = i * 1e-9"
+for _ = 1, nstmt do
+  local r = {}
+  for j = 1, 4 do
+    seed = seed * 16807 % 2147483647
+    r[j] = seed
+  end
+  src[#src+1] = ("  v%d = v%d * 0.5 + x * k%d + k%d"):format(
+    r[1] % nv + 1, r[2] % nv + 1, r[3] % nk + 1, r[4] % nk + 1)
+end
+src[#src+1] = "end"
+src[#src+1] = "return v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8"
+src = table.concat(src, "\n")
+
+for _, mode in ipairs({ "greedy", "belady" }) do
+  jit.flush()
+  jit.opt.start("regalloc=" .. mode)
+  local kernel = assert(load(src))
+  local t0 = os.clock()
+  local res = kernel(n)
+  local dt = os.clock() - t0
+  local spills, tr = 0, 1
+  while true do
+    local info = jutil.traceinfo(tr)
+    if not info then break end
+    spills = spills + (info.nspill or 0)
+    tr = tr + 1
+  end
+  print(string.format("%-7s %8.3fs  spills %4d  checksum %.9g", mode, dt,
+		      spills, res))
+end
+
+jit.opt.start("regalloc=greedy")
@@ -0,0 +1,58 @@
+----------------------------------------------------------------------------
+-- LuaJIT module to save C declarations as a cdef blob.
+--
+-- Copyright (C) 2005-2020 Mike Pall. All rights reserved.
+-- Released under the MIT license. See Copyright Notice in luajit.h
+----------------------------------------------------------------------------
+--
+-- This module parses C header files with ffi.cdef() and saves the
+-- resulting C types as a binary blob. Load the blob with
+-- ffi.load_cdefs() instead of parsing the headers in every process.
+--
+-- Example usage:
+--
+--   luajit -jcdefsave=myapp.cdb,foo.h,bar.h
+--
+-- The first argument is the output file name ('-' for stdout). All
+-- following arguments are header files, which are declared in order.
+-- The headers must not contain any pre-processor directives except
+-- #pragma pack, same as for ffi.cdef().
+--
+-- A blob can only be loaded by the same LuaJIT build for the same
+-- architecture it was created with.
+--
+------------------------------------------------------------------------------
+
+local jit = require("jit")
+assert(jit.version_num == 20100, "LuaJIT core/library version mismatch")
+local ffi = require("ffi")
+
+local function check(ok, ...)
+  if ok then return ok, ... end
+  io.stderr:write("luajit: ", ...)
+  io.stderr:write("\n")
+  os.exit(1)
+end
+
+local function start(output, ...)
+  if not output or select("#", ...) == 0 then
+    io.stderr:write("Save C declarations: luajit -jcdefsave=output,input...\n")
+    os.exit(1)
+  end
+  for i = 1, select("#", ...) do
+    local name = select(i, ...)
+    local fp = check(io.open(name, "r"))
+    local def = fp:read("*a")
+    fp:close()
+    check(pcall(ffi.cdef, def))
+  end
+  local fp = output == "-" and io.stdout or check(io.open(output, "wb"))
+  fp:write(ffi.save_cdefs())
+  if fp ~= io.stdout then fp:close() end
+  os.exit(0)
+end
+
+-- Public module functions.
+return {
+  start = start,
+}
@@ -231,6 +231,11 @@ LJLIB_CF(unpack)
   n = (int32_t)(nu+1);
   if (nu >= LUAI_MAXCSTACK || !lua_checkstack(L, n))
     lj_err_caller(L, LJ_ERR_UNPACK);
+  if (i >= 0 && (uint32_t)e < t->asize) {  /* Copy straight from array. */
+    memcpy(L->top, arrayslot(t, i), (size_t)n*sizeof(TValue));
+    L->top += n;
+    return n;
+  }
   do {
     cTValue *tv = lj_tab_getint(t, i);
     if (tv) {
@@ -36,12 +36,13 @@
 /* -- C type checks ------------------------------------------------------- */
 
 /* Check first argument for a C type and returns its ID. */
-static CTypeID ffi_checkctype(lua_State *L, CTState *cts, TValue *param)
+static CTypeID ffi_checkctypearg(lua_State *L, CTState *cts, int narg,
+				 TValue *param)
 {
-  TValue *o = L->base;
+  TValue *o = L->base + narg-1;
   if (!(o < L->top)) {
   err_argtype:
-    lj_err_argtype(L, 1, "C type");
+    lj_err_argtype(L, narg, "C type");
   }
   if (tvisstr(o)) {  /* Parse an abstract C type declaration. */
     GCstr *s = strV(o);
@@ -59,12 +60,14 @@ static CTypeID ffi_checkctype(lua_State *L, CTState *cts, TValue *param)
   } else {
     GCcdata *cd;
     if (!tviscdata(o)) goto err_argtype;
-    if (param && param < L->top) lj_err_arg(L, 1, LJ_ERR_FFI_NUMPARAM);
+    if (param && param < L->top) lj_err_arg(L, narg, LJ_ERR_FFI_NUMPARAM);
     cd = cdataV(o);
     return cd->ctypeid == CTID_CTYPEID ? *(CTypeID *)cdataptr(cd) : cd->ctypeid;
   }
 }
 
+#define ffi_checkctype(L, cts, param)	ffi_checkctypearg(L, cts, 1, param)
+
 /* Check argument for C data and return it. */
 static GCcdata *ffi_checkcdata(lua_State *L, int narg)
 {
@@ -505,6 +508,68 @@ LJLIB_PUSH(top-1) LJLIB_SET(__index)
 
 #include "lj_libdef.h"
 
+/* -- Arena methods ------------------------------------------------------- */
+
+#define LJLIB_MODULE_ffi_arena
+
+static CArena *ffi_checkarena(lua_State *L)
+{
+  TValue *o = L->base;
+  if (!(o < L->top && tvisudata(o) && udataV(o)->udtype == UDTYPE_FFI_ARENA))
+    lj_err_argt(L, 1, LUA_TUSERDATA);
+  return (CArena *)uddata(udataV(o));
+}
+
+LJLIB_CF(ffi_arena_new)	LJLIB_REC(.)
+{
+  CArena *ca = ffi_checkarena(L);
+  CTState *cts = ctype_cts(L);
+  CTypeID id = ffi_checkctypearg(L, cts, 2, NULL);
+  CType *ct = ctype_raw(cts, id);
+  CTSize sz, asz;
+  CTInfo info = lj_ctype_info(cts, id, &sz);
+  TValue *o = L->base+2;
+  uintptr_t align;
+  char *p;
+  GCcdata *cd;
+  if ((info & CTF_VLA)) {
+    o++;
+    sz = lj_ctype_vlsize(cts, ct, (CTSize)ffi_checkint(L, 3));
+  }
+  if (sz == CTSIZE_INVALID || sz > LJ_MAX_MEM32)
+    lj_err_arg(L, 2, LJ_ERR_FFI_INVSIZE);
+  /* Keep the bump pointer aligned for all types up to CT_MEMALIGN. */
+  align = (uintptr_t)1 << (ctype_align(info) > CT_MEMALIGN ?
+			   ctype_align(info) : CT_MEMALIGN);
+  p = (char *)(((uintptr_t)ca->top + align-1) & ~(align-1));
+  asz = (sz + (1u<<CT_MEMALIGN)-1) & ~((1u<<CT_MEMALIGN)-1);
+  if (p > ca->end || asz > (CTSize)(ca->end - p))
+    lj_err_caller(L, LJ_ERR_FFI_ARENAOV);
+  lj_cconv_ct_init(cts, ct, sz, (uint8_t *)p,
+		   o, (MSize)(L->top - o));  /* Initialize data. */
+  ca->top = p + asz;
+  /* Return a pointer to the object or to the first element of an array. */
+  if (ctype_isrefarray(ct->info)) id = ctype_cid(ct->info);
+  id = lj_ctype_intern(cts, CTINFO(CT_PTR, CTALIGN_PTR|id), CTSIZE_PTR);
+  cd = lj_cdata_new(cts, id, CTSIZE_PTR);
+  *(void **)cdataptr(cd) = p;
+  L->top = L->base+1;
+  setcdataV(L, L->base, cd);
+  lj_gc_check(L);
+  return 1;
+}
+
+LJLIB_CF(ffi_arena_reset)	LJLIB_REC(.)
+{
+  CArena *ca = ffi_checkarena(L);
+  ca->top = carena_base(ca);
+  return 0;
+}
+
+LJLIB_PUSH(top-1) LJLIB_SET(__index)
+
+#include "lj_libdef.h"
+
 /* -- FFI library functions ----------------------------------------------- */
 
 #define LJLIB_MODULE_ffi
@@ -526,6 +591,22 @@ LJLIB_CF(ffi_cdef)
   return 0;
 }
 
+LJLIB_CF(ffi_save_cdefs)
+{
+  setstrV(L, L->top++, lj_ctype_save(ctype_cts(L)));
+  lj_gc_check(L);
+  return 1;
+}
+
+LJLIB_CF(ffi_load_cdefs)
+{
+  GCstr *s = lj_lib_checkstr(L, 1);
+  int errcode = lj_ctype_load(ctype_cts(L), s);
+  if (errcode) lj_err_throw(L, errcode);  /* Propagate errors. */
+  lj_gc_check(L);
+  return 0;
+}
+
 LJLIB_CF(ffi_new)	LJLIB_REC(.)
 {
   CTState *cts = ctype_cts(L);
@@ -772,6 +853,81 @@ LJLIB_CF(ffi_fill)	LJLIB_REC(.)
   return 0;
 }
 
+LJLIB_CF(ffi_fromtable)
+{
+  CTState *cts = ctype_cts(L);
+  CTypeID id = ffi_checkctype(L, cts, NULL);
+  CType *ct = ctype_raw(cts, id);
+  GCtab *t = lj_lib_checktab(L, 2);
+  CTSize sz;
+  CTInfo info = lj_ctype_info(cts, id, &sz);
+  GCcdata *cd;
+  if (!ctype_isarray(ct->info))
+    lj_err_arg(L, 1, LJ_ERR_FFI_INVTYPE);
+  if ((info & CTF_VLA)) {  /* Size a VLA to fit the table. */
+    MSize n = (MSize)lj_tab_len(t);
+    cTValue *tv = lj_tab_getint(t, 0);
+    if (tv && !tvisnil(tv)) n++;
+    sz = lj_ctype_vlsize(cts, ct, n);
+  }
+  if (sz == CTSIZE_INVALID)
+    lj_err_arg(L, 1, LJ_ERR_FFI_INVSIZE);
+  cd = lj_cdata_newx(cts, id, sz, info);
+  setcdataV(L, L->base, cd);  /* Anchor the uninitialized cdata. */
+  lj_cconv_ct_init(cts, ct, sz, cdataptr(cd), L->base+1, 1);
+  L->top = L->base+1;
+  lj_gc_check(L);
+  return 1;
+}
+
+LJLIB_CF(ffi_totable)
+{
+  CTState *cts = ctype_cts(L);
+  GCcdata *cd = ffi_checkcdata(L, 1);
+  CType *ct = ctype_raw(cts, cd->ctypeid), *dc;
+  uint8_t *p = cdataptr(cd);
+  int32_t n = -1;
+  GCtab *t;
+  TValue *o;
+  int32_t i;
+  int gcsteps = 0;
+  if (ctype_isref(ct->info)) {
+    p = *(uint8_t **)p;
+    ct = ctype_rawchild(cts, ct);
+  }
+  if (ctype_isptr(ct->info)) {
+    p = (uint8_t *)cdata_getptr(p, ct->size);
+  } else if (ctype_isarray(ct->info)) {
+    CTSize sz = cdataisv(cd) ? cdatavlen(cd) : ct->size;
+    dc = ctype_rawchild(cts, ct);
+    if (sz != CTSIZE_INVALID && dc->size != 0)
+      n = (int32_t)(sz / dc->size);
+  } else {
+    lj_err_arg(L, 1, LJ_ERR_FFI_INVTYPE);
+  }
+  if (L->base+1 < L->top && !tvisnil(L->base+1))
+    n = ffi_checkint(L, 2);
+  else if (n < 0)
+    lj_err_arg(L, 2, LJ_ERR_NOVAL);
+  if (n < 0 || n > LJ_MAX_ASIZE-1)
+    lj_err_arg(L, 2, LJ_ERR_BADVAL);
+  dc = ctype_rawchild(cts, ct);
+  if (dc->size == CTSIZE_INVALID || (dc->size == 0 && n != 0))
+    lj_err_arg(L, 1, LJ_ERR_FFI_INVSIZE);
+  t = lj_tab_new(L, (uint32_t)n+1, 0);
+  L->top = L->base+1;
+  settabV(L, L->base, t);  /* Anchor the result table. */
+  o = tvref(t->array) + 1;
+  if (!lj_cconv_tv_numarray(dc, o, p, (MSize)n)) {
+    /* NOBARRIER: The table is new and no GC step happens in between. */
+    for (i = 0; i < n; i++)
+      gcsteps += lj_cdata_get(cts, ct, &o[i], p + (MSize)i * dc->size);
+  }
+  if (gcsteps)
+    lj_gc_check(L);
+  return 1;
+}
+
 /* Test ABI string. */
 LJLIB_CF(ffi_abi)	LJLIB_REC(.)
 {
@@ -813,8 +969,8 @@ LJLIB_CF(ffi_abi)	LJLIB_REC(.)
   return 1;
 }
 
-LJLIB_PUSH(top-8) LJLIB_SET(!)  /* Store reference to miscmap table. */
-LJLIB_PUSH(top-8) LJLIB_SET(miscmap) /* Expose to user. */
+LJLIB_PUSH(top-9) LJLIB_SET(!)  /* Store reference to miscmap table. */
+LJLIB_PUSH(top-9) LJLIB_SET(miscmap) /* Expose to user. */
 
 LJLIB_CF(ffi_metatype)
 {
@@ -852,7 +1008,7 @@ LJLIB_CF(ffi_metatype)
   return 1;
 }
 
-LJLIB_PUSH(top-7) LJLIB_SET(!)  /* Store reference to finalizer table. */
+LJLIB_PUSH(top-8) LJLIB_SET(!)  /* Store reference to finalizer table. */
 
 LJLIB_CF(ffi_gc)	LJLIB_REC(.)
 {
@@ -868,7 +1024,7 @@ LJLIB_CF(ffi_gc)	LJLIB_REC(.)
   return 1;
 }
 
-LJLIB_PUSH(top-5) LJLIB_SET(!)  /* Store clib metatable in func environment. */
+LJLIB_PUSH(top-6) LJLIB_SET(!)  /* Store clib metatable in func environment. */
 
 LJLIB_CF(ffi_load)
 {
@@ -878,6 +1034,48 @@ LJLIB_CF(ffi_load)
   return 1;
 }
 
+LJLIB_CF(ffi_bind)
+{
+  TValue *o = L->base;
+  CLibrary *cl;
+  GCtab *names, *t;
+  MSize i, n;
+  if (!(o < L->top && tvisudata(o) && udataV(o)->udtype == UDTYPE_FFI_CLIB))
+    lj_err_argt(L, 1, LUA_TUSERDATA);
+  cl = (CLibrary *)uddata(udataV(o));
+  names = lj_lib_checktab(L, 2);
+  n = lj_tab_len(names);
+  t = lj_tab_new(L, 0, hsize2hbits(n));
+  settabV(L, L->top++, t);
+  for (i = 1; i <= n; i++) {
+    cTValue *name = lj_tab_getint(names, (int32_t)i);
+    TValue *tv;
+    if (!(name && tvisstr(name)))
+      lj_err_arg(L, 2, LJ_ERR_BADVAL);
+    tv = lj_clib_index(L, cl, strV(name));
+    if (tviscdata(tv) &&
+	ctype_isextern(ctype_get(ctype_cts(L), cdataV(tv)->ctypeid)->info))
+      lj_err_arg(L, 2, LJ_ERR_FFI_INVTYPE);  /* Only functions/constants. */
+    /* NOBARRIER: The table is new (marked white). */
+    copyTV(L, lj_tab_setstr(L, t, strV(name)), tv);
+  }
+  lj_gc_check(L);
+  return 1;
+}
+
+LJLIB_PUSH(top-5) LJLIB_SET(!)  /* Store arena metatable in func environment. */
+
+LJLIB_CF(ffi_arena)
+{
+  int32_t size = lj_lib_checkint(L, 1);
+  if (size <= 0 || (MSize)size > LJ_MAX_UDATA - (MSize)sizeof(CArena))
+    lj_err_arg(L, 1, LJ_ERR_BADVAL);
+  size = (int32_t)(((MSize)size + (1u<<CT_MEMALIGN)-1) &
+		   ~((1u<<CT_MEMALIGN)-1));
+  lj_cdata_newarena(L, (MSize)size, tabref(curr_func(L)->c.env));
+  return 1;
+}
+
 LJLIB_PUSH(top-4) LJLIB_SET(C)
 LJLIB_PUSH(top-3) LJLIB_SET(os)
 LJLIB_PUSH(top-2) LJLIB_SET(arch)
@@ -925,7 +1123,8 @@ LUALIB_API int luaopen_ffi(lua_State *L)
   /* NOBARRIER: the key is new and lj_tab_newkey() handles the barrier. */
   settabV(L, lj_tab_setstr(L, cts->miscmap, &cts->g->strempty), tabV(L->top-1));
   L->top--;
-  lj_clib_default(L, tabV(L->top-1));  /* Create ffi.C default namespace. */
+  LJ_LIB_REG(L, NULL, ffi_arena);
+  lj_clib_default(L, tabV(L->top-2));  /* Create ffi.C default namespace. */
   lua_pushliteral(L, LJ_OS_NAME);
   lua_pushliteral(L, LJ_ARCH_NAME);
   LJ_LIB_REG(L, NULL, ffi);  /* Note: no global "ffi" created! */
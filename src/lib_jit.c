@@ -3,6 +3,9 @@
 ** Copyright (C) 2005-2020 Mike Pall. See Copyright Notice in luajit.h
 */
 
+#include <stdio.h>
+#include <string.h>
+
 #define lib_jit_c
 #define LUA_LIB
 
@@ -148,6 +151,125 @@ LJLIB_CF(jit_attach)
   return 0;
 }
 
+#if LJ_HASJIT
+#define WARM_HEADER	"LJWARM 1\n"
+
+/* Check whether a bytecode starts a hotcounted root trace. */
+static int warm_isstart(BCOp op)
+{
+  return op == BC_FORL || op == BC_ITERL || op == BC_LOOP ||
+	 op == BC_FUNCF || op == BC_FUNCV;
+}
+#endif
+
+/* Save the starting points of all root traces as warm start hints. */
+LJLIB_CF(jit_savetraces)
+{
+  const char *path = strdata(lj_lib_checkstr(L, 1));
+  int32_t n = 0;
+#if LJ_HASJIT
+  jit_State *J = L2J(L);
+  FILE *fp = fopen(path, "w");
+  TraceNo i;
+  if (!fp)
+    return luaL_fileresult(L, 0, path);
+  fputs(WARM_HEADER, fp);
+  for (i = 1; i < (TraceNo)J->sizetrace; i++) {
+    GCtrace *T = traceref(J, i);
+    if (T && T != &J->cur && T->root == 0 &&
+	warm_isstart(bc_op(T->startins))) {
+      GCproto *pt = &gcref(T->startpt)->pt;
+      TraceWarm w;
+      lj_trace_warmkey(pt, &w);
+      w.pos = proto_bcpos(pt, mref(T->startpc, const BCIns));
+      fprintf(fp, "%08x %08x %d %u\n", w.chunkhash, w.bchash,
+	      (int)w.firstline, (unsigned)w.pos);
+      n++;
+    }
+  }
+  if (fclose(fp) != 0)
+    return luaL_fileresult(L, 0, path);
+#else
+  UNUSED(path);
+#endif
+  setintV(L->top++, n);
+  return 1;
+}
+
+#if LJ_HASJIT
+/* Open a warm start file and skip its header. Returns NULL on error. */
+static FILE *warm_open(const char *path, int *bad)
+{
+  FILE *fp = fopen(path, "r");
+  char buf[sizeof(WARM_HEADER)+1];
+  *bad = 0;
+  if (fp && (!fgets(buf, sizeof(buf), fp) || strcmp(buf, WARM_HEADER))) {
+    fclose(fp);
+    fp = NULL;
+    *bad = 1;
+  }
+  return fp;
+}
+
+/* Parse the next warm start hint. Returns 0 at the end of the file. */
+static int warm_next(FILE *fp, TraceWarm *w)
+{
+  char buf[80];
+  while (fgets(buf, sizeof(buf), fp)) {
+    unsigned int ch, bh, pos;
+    int line;
+    if (sscanf(buf, "%x %x %d %u", &ch, &bh, &line, &pos) == 4) {
+      w->chunkhash = ch;
+      w->bchash = bh;
+      w->firstline = (BCLine)line;
+      w->pos = (BCPos)pos;
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif
+
+/* Load warm start hints. They apply to all chunks loaded afterwards. */
+LJLIB_CF(jit_loadtraces)
+{
+  const char *path = strdata(lj_lib_checkstr(L, 1));
+  MSize n = 0;
+#if LJ_HASJIT
+  jit_State *J = L2J(L);
+  TraceWarm w;
+  int bad;
+  FILE *fp = warm_open(path, &bad);
+  if (!fp)
+    goto fail;
+  /* Count first, so the file isn't leaked if the allocation fails. */
+  while (warm_next(fp, &w))
+    n++;
+  fclose(fp);
+  lj_trace_warmreset(L, n);
+  if (n) {
+    if (!(fp = warm_open(path, &bad)))
+      goto fail;
+    while (J->nwarm < n && warm_next(fp, &w))
+      lj_trace_warmadd(J, &w);
+    fclose(fp);
+  }
+  n = J->nwarm;
+#else
+  UNUSED(path);
+#endif
+  setintV(L->top++, (int32_t)n);
+  return 1;
+#if LJ_HASJIT
+fail:
+  if (!bad)
+    return luaL_fileresult(L, 0, path);
+  setnilV(L->top++);
+  lua_pushfstring(L, "%s: not a trace warm start file", path);
+  return 2;
+#endif
+}
+
 LJLIB_PUSH(top-5) LJLIB_SET(os)
 LJLIB_PUSH(top-4) LJLIB_SET(arch)
 LJLIB_PUSH(top-3) LJLIB_SET(version_num)
@@ -314,6 +436,7 @@ LJLIB_CF(jit_util_traceinfo)
     setintfield(L, t, "nk", REF_BIAS - (int32_t)T->nk);
     setintfield(L, t, "link", T->link);
     setintfield(L, t, "nexit", T->nsnap);
+    setintfield(L, t, "nspill", T->nspill);
     setstrV(L, L->top++, lj_str_newz(L, jit_trlinkname[T->linktype]));
     lua_setfield(L, -2, "linktype");
     /* There are many more fields. Add them only when needed. */
@@ -509,9 +632,24 @@ static int jitopt_param(jit_State *J, const char *str)
     if (strncmp(str, lst+1, len) == 0 && str[len] == '=') {
       int32_t n = 0;
       const char *p = &str[len+1];
+      if (i == JIT_P_regalloc && !(*p >= '0' && *p <= '9')) {
+	const char *opt = JIT_RA_STRING;
+	for (; *opt; n++, opt += 1+*opt)  /* Named value. */
+	  if (strncmp(p, opt+1, *opt) == 0 && p[(int)*opt] == '\0') {
+	    p += *opt;
+	    break;
+	  }
+	if (!*opt) return 0;  /* Unknown name. */
+      }
       while (*p >= '0' && *p <= '9')
 	n = n*10 + (*p++ - '0');
       if (*p) return 0;  /* Malformed number. */
+      if (i == JIT_P_regalloc && n > JIT_RA_BELADY)
+	return 0;  /* Unknown heuristic. */
+      if (i == JIT_P_reoptthreshold && n > 255)
+	n = 255;  /* Limited by the width of GCtrace.hotloopexits. */
+      else if (i == JIT_P_pic && n > PIC_WAYS)
+	n = PIC_WAYS;  /* Limited by the size of PICSite.sig[]. */
       J->param[i] = n;
       if (i == JIT_P_hotloop)
 	lj_dispatch_init_hotcount(J2G(J));
@@ -13,6 +13,9 @@
 #include "lualib.h"
 
 #include "lj_obj.h"
+#if LJ_53 && LJ_HASFFI
+#include "lj_ctype.h"
+#endif
 #include "lj_lib.h"
 #include "lj_vm.h"
 #include "lj_prng.h"
@@ -95,6 +98,22 @@ LJLIB_ASM(math_min)		LJLIB_REC(math_minmax IR_MIN)
 }
 LJLIB_ASM_(math_max)		LJLIB_REC(math_minmax IR_MAX)
 
+#if LJ_53
+/* Numbers have no integer subtype. Only 64 bit integer cdata counts. */
+LJLIB_CF(math_type)
+{
+  cTValue *o = lj_lib_checkany(L, 1);
+  if (tvisnumber(o))
+    lua_pushliteral(L, "float");
+  else if (LJ_HASFFI && tviscdata(o) && (cdataV(o)->ctypeid == CTID_INT64 ||
+					 cdataV(o)->ctypeid == CTID_UINT64))
+    lua_pushliteral(L, "integer");
+  else
+    setnilV(L->top++);
+  return 1;
+}
+#endif
+
 LJLIB_PUSH(3.14159265358979323846) LJLIB_SET(pi)
 LJLIB_PUSH(1e310) LJLIB_SET(huge)
 
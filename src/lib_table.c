@@ -17,9 +17,127 @@
 #include "lj_gc.h"
 #include "lj_err.h"
 #include "lj_buf.h"
+#include "lj_str.h"
 #include "lj_tab.h"
+#include "lj_meta.h"
 #include "lj_ff.h"
 #include "lj_lib.h"
+#include "lj_udata.h"
+
+/* -- Typed array metamethods -------------------------------------------- */
+
+#define LJLIB_MODULE_table_typed
+
+static GCudata *tarr_check(lua_State *L)
+{
+  TValue *o = L->base;
+  if (!(o < L->top && tvisudata(o) && udistarr(udataV(o))))
+    lj_err_argt(L, 1, LUA_TUSERDATA);
+  return udataV(o);
+}
+
+/* Get pointer to element for key. Returns NULL for non-integer keys and
+** for keys out of range.
+*/
+static uint8_t *tarr_ref(GCudata *ud, cTValue *key)
+{
+  TypedArray *ta = (TypedArray *)uddata(ud);
+  int32_t k;
+  if (tvisint(key)) {
+    k = intV(key);
+  } else if (tvisnum(key)) {
+    lua_Number n = numV(key);
+    k = lj_num2int(n);
+    if (n != (lua_Number)k) return NULL;
+  } else {
+    return NULL;
+  }
+  if ((MSize)(k-1) >= ta->len) return NULL;
+  return tarr_data(ta) + (MSize)(k-1) * tarr_esize(ud->udtype);
+}
+
+/* Load element. */
+static void tarr_get(GCudata *ud, uint8_t *p, TValue *o)
+{
+  switch (ud->udtype) {
+  case UDTYPE_TARR_F64: setnumV(o, *(double *)p); break;
+  case UDTYPE_TARR_I32: setintV(o, *(int32_t *)p); break;
+  case UDTYPE_TARR_U8: setintV(o, *p); break;
+  default: setboolV(o, *p != 0); break;
+  }
+}
+
+LJLIB_CF(table_typed___index)	LJLIB_REC(tarr_index 0)
+{
+  GCudata *ud = tarr_check(L);
+  uint8_t *p = tarr_ref(ud, lj_lib_checkany(L, 2));
+  if (p)
+    tarr_get(ud, p, L->top-1);
+  else
+    setnilV(L->top-1);
+  return 1;
+}
+
+LJLIB_CF(table_typed___newindex)	LJLIB_REC(tarr_index 1)
+{
+  GCudata *ud = tarr_check(L);
+  uint8_t *p = tarr_ref(ud, lj_lib_checkany(L, 2));
+  TValue *o = lj_lib_checkany(L, 3);
+  if (!p)
+    lj_err_arg(L, 2, LJ_ERR_IDXRNG);
+  if (ud->udtype == UDTYPE_TARR_BOOL) {
+    if (!tvisbool(o))
+      lj_err_argt(L, 3, LUA_TBOOLEAN);
+    *p = (uint8_t)boolV(o);
+  } else {
+    lua_Number n;
+    if (tvisint(o)) n = (lua_Number)intV(o);
+    else if (tvisnum(o)) n = numV(o);
+    else lj_err_argt(L, 3, LUA_TNUMBER);
+    if (ud->udtype == UDTYPE_TARR_F64)
+      *(double *)p = n;
+    else if (ud->udtype == UDTYPE_TARR_I32)
+      *(int32_t *)p = lj_num2int(n);
+    else
+      *p = (uint8_t)lj_num2int(n);
+  }
+  return 0;
+}
+
+LJLIB_CF(table_typed___len)	LJLIB_REC(tarr_len)
+{
+  GCudata *ud = tarr_check(L);
+  setintV(L->top-1, (int32_t)((TypedArray *)uddata(ud))->len);
+  return 1;
+}
+
+LJLIB_NOREGUV LJLIB_CF(table_typed_ipairs_aux)	LJLIB_REC(tarr_ipairs_aux)
+{
+  GCudata *ud = tarr_check(L);
+  int32_t i = lj_lib_checkint(L, 2) + 1;
+  uint8_t *p;
+  setintV(L->base+1, i);
+  p = tarr_ref(ud, L->base+1);
+  if (!p) return 0;
+  tarr_get(ud, p, L->base+2);
+  L->top = L->base+3;
+  return 2;
+}
+
+LJLIB_PUSH(lastcl)
+LJLIB_CF(table_typed___ipairs)	LJLIB_REC(tarr_ipairs)
+{
+  tarr_check(L);
+  L->top = L->base+3;
+  copyTV(L, L->base+1, L->base);
+  setfuncV(L, L->base, funcV(lj_lib_upvalue(L, 1)));
+  setintV(L->base+2, 0);
+  return 3;
+}
+
+LJLIB_PUSH("typed") LJLIB_SET(__metatable)
+
+#include "lj_libdef.h"
 
 /* ------------------------------------------------------------------------ */
 
@@ -129,25 +247,63 @@ LJLIB_LUA(table_remove) /*
   end
 */
 
-LJLIB_LUA(table_move) /*
-  function(a1, f, e, t, a2)
-    CHECK_tab(a1)
-    CHECK_int(f)
-    CHECK_int(e)
-    CHECK_int(t)
-    if a2 == nil then a2 = a1 end
-    CHECK_tab(a2)
-    if e >= f then
-      local d = t - f
-      if t > e or t <= f or a2 ~= a1 then
-	for i=f,e do a2[i+d] = a1[i] end
-      else
-	for i=e,f,-1 do a2[i+d] = a1[i] end
-      end
-    end
-    return a2
-  end
-*/
+LJLIB_CF(table_move)		LJLIB_REC(.)
+{
+  GCtab *a1 = lj_lib_checktab(L, 1);
+  int32_t f = lj_lib_checkint(L, 2);
+  int32_t e = lj_lib_checkint(L, 3);
+  int32_t t = lj_lib_checkint(L, 4);
+  int tt = (L->base+4 < L->top && !tvisnil(L->base+4)) ? 5 : 1;
+  GCtab *a2 = tt == 5 ? lj_lib_checktab(L, 5) : a1;
+  if (e >= f) {
+    uint32_t n = (uint32_t)((int64_t)e - f) + 1, k;
+    if ((int64_t)e - f >= INT32_MAX)
+      lj_err_arg(L, 3, LJ_ERR_TABMOVE);
+    if ((int64_t)t + n - 1 > INT32_MAX)
+      lj_err_arg(L, 4, LJ_ERR_TABWRAP);
+    if (!lj_meta_fast(L, tabref(a1->metatable), MM_index) &&
+	!lj_meta_fast(L, tabref(a2->metatable), MM_newindex)) {
+      lj_tab_move(L, a1, f, e, t, a2);
+    } else if (t > e || t <= f || a2 != a1) {  /* Respect __index/__newindex. */
+      for (k = 0; k < n; k++) {
+	lua_geti(L, 1, (lua_Integer)f + k);
+	lua_seti(L, tt, (lua_Integer)t + k);
+      }
+    } else {
+      for (k = n; k-- > 0; ) {
+	lua_geti(L, 1, (lua_Integer)f + k);
+	lua_seti(L, tt, (lua_Integer)t + k);
+      }
+    }
+  }
+  settabV(L, L->top++, a2);
+  return 1;
+}
+
+LJLIB_CF(table_fill)		LJLIB_REC(.)
+{
+  GCtab *t = lj_lib_checktab(L, 1);
+  TValue v;
+  int32_t i, e;
+  copyTV(L, &v, lj_lib_checkany(L, 2));
+  i = lj_lib_optint(L, 3, 1);
+  if (L->base+3 < L->top && !tvisnil(L->base+3))
+    e = lj_lib_checkint(L, 4);
+  else if (lj_meta_fast(L, tabref(t->metatable), MM_len))
+    e = (int32_t)luaL_len(L, 1);
+  else
+    e = (int32_t)lj_tab_len(t);
+  if (e < i) return 0;
+  if (!lj_meta_fast(L, tabref(t->metatable), MM_newindex)) {
+    lj_tab_fill(L, t, i, e, &v);
+  } else {  /* Need to respect __newindex. */
+    do {
+      copyTV(L, L->top++, &v);
+      lua_seti(L, 1, i);
+    } while (i++ < e);
+  }
+  return 0;
+}
 
 LJLIB_CF(table_concat)		LJLIB_REC(.)
 {
@@ -283,7 +439,7 @@ LJLIB_CF(table_pack)
   return 1;
 }
 
-LJLIB_NOREG LJLIB_CF(table_new)		LJLIB_REC(.)
+LJLIB_CF(table_new)		LJLIB_REC(.)
 {
   int32_t a = lj_lib_checkint(L, 1);
   int32_t h = lj_lib_checkint(L, 2);
@@ -291,6 +447,33 @@ LJLIB_NOREG LJLIB_CF(table_new)		LJLIB_REC(.)
   return 1;
 }
 
+LJLIB_PUSH(top-2) LJLIB_SET(!)  /* Store typed array metatable in env. */
+
+/* Create a typed array with unboxed, zero-filled elements 1..n. */
+LJLIB_CF(table_typed)
+{
+  int k = lj_lib_checkopt(L, 1, -1, "\3f64\3i32\2u8\4bool");
+  int32_t n = lj_lib_checkint(L, 2);
+  GCtab *mt = tabref(curr_func(L)->c.env);
+  uint32_t udtype = UDTYPE_TARR_F64 + (uint32_t)k;
+  MSize esz = tarr_esize(udtype);
+  GCudata *ud;
+  TypedArray *ta;
+  if (n < 0 || (MSize)n > (LJ_MAX_UDATA - (MSize)sizeof(TypedArray)) / esz)
+    lj_err_arg(L, 2, LJ_ERR_BADVAL);
+  ud = lj_udata_new(L, (MSize)sizeof(TypedArray) + (MSize)n*esz, mt);
+  ud->udtype = (uint8_t)udtype;
+  /* NOBARRIER: The GCudata is new (marked white). */
+  setgcref(ud->metatable, obj2gco(mt));
+  ta = (TypedArray *)uddata(ud);
+  ta->len = (MSize)n;
+  ta->unused = 0;
+  memset(tarr_data(ta), 0, (size_t)n*esz);
+  setudataV(L, L->top++, ud);
+  lj_gc_check(L);
+  return 1;
+}
+
 LJLIB_NOREG LJLIB_CF(table_clear)	LJLIB_REC(.)
 {
   lj_tab_clear(lj_lib_checktab(L, 1));
@@ -299,6 +482,13 @@ LJLIB_NOREG LJLIB_CF(table_clear)	LJLIB_REC(.)
 
 static int luaopen_table_new(lua_State *L)
 {
+  /* Already registered by default. Hand out the same function, if it's there. */
+  GCtab *t = tabref(curr_func(L)->c.env);
+  cTValue *o = lj_tab_getstr(t, lj_str_newlit(L, "new"));
+  if (o && tvisfunc(o) && funcV(o)->c.ffid == FF_table_new) {
+    copyTV(L, L->top++, o);
+    return 1;
+  }
   return lj_lib_postreg(L, lj_cf_table_new, FF_table_new, "new");
 }
 
@@ -313,6 +503,10 @@ static int luaopen_table_clear(lua_State *L)
 
 LUALIB_API int luaopen_table(lua_State *L)
 {
+  LJ_LIB_REG(L, NULL, table_typed);
+  /* Iterating with pairs() gives the same order. */
+  lua_getfield(L, -1, "__ipairs");
+  lua_setfield(L, -2, "__pairs");
   LJ_LIB_REG(L, LUA_TABLIBNAME, table);
 
   /* Ugh, this field juggling is messy. Because they live in different modules
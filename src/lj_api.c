@@ -889,19 +889,18 @@ LUA_API int lua_gettable(lua_State *L, int idx)
 
 LUA_API int lua_geti(lua_State *L, int idx, lua_Integer i)
 {
-  cTValue *v, *t = index2adr(L, idx);
-  if (!(v = lj_tab_getint(tabV(t), i))) {
-    TValue k;
-    setnumV(&k, (lua_Number)i);
-    v = lj_meta_tget(L, t, &k);
-  }
+  cTValue *v, *t = index2adr_check(L, idx);
+  TValue k;
+  setnumV(&k, (lua_Number)i);
+  v = lj_meta_tget(L, t, &k);
   if (v == NULL) {
     L->top += 2;
     lj_vm_call(L, L->top-2, 1+1);
     L->top -= 2+LJ_FR2;
     v = L->top+1+LJ_FR2;
   }
-  copyTV(L, L->top-1, v);
+  copyTV(L, L->top, v);
+  incr_top(L);
   return ljx_tv2type(L, v);
 }
 
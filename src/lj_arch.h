@@ -559,6 +559,13 @@
 #define LJ_HASFFI		1
 #endif
 
+/* Enable table size feedback from the trace recorder (experimental). */
+#if defined(LUAJIT_ENABLE_TABLE_BUMP) && LJ_HASJIT
+#define LJ_HASTABBUMP		1
+#else
+#define LJ_HASTABBUMP		0
+#endif
+
 #if defined(LUAJIT_DISABLE_PROFILE)
 #define LJ_HASPROFILE		0
 #elif LJ_TARGET_POSIX
@@ -93,6 +93,9 @@ typedef struct ASMState {
   intptr_t krefk[RID_NUM_KREF];
 #endif
   IRRef1 phireg[RID_MAX];  /* PHI register references. */
+  IRRef1 *nextuse;	/* Nearest use of each ref for regalloc=belady (or NULL). */
+  IRRef1 *prevuse;	/* Previous uses of both operands of each ins. */
+  uint32_t nspill;	/* Number of spill stores and reloads. */
   uint16_t parentmap[LJ_MAX_JSLOTS];  /* Parent instruction to RegSP map. */
 } ASMState;
 
@@ -429,6 +432,7 @@ static Reg ra_restore(ASMState *as, IRRef ref)
     if (!rset_test(as->weakset, r)) {  /* Only restore non-weak references. */
       ra_modified(as, r);
       RA_DBGX((as, "restore   $i $r", ir, r));
+      as->nspill++;
       emit_spload(as, ir, r, ofs);
     }
     return r;
@@ -439,9 +443,87 @@ static Reg ra_restore(ASMState *as, IRRef ref)
 static void ra_save(ASMState *as, IRIns *ir, Reg r)
 {
   RA_DBGX((as, "save      $i $r", ir, r));
+  as->nspill++;
   emit_spstore(as, ir, r, sps_scale(ir->s));
 }
 
+/* -- Next-use eviction for regalloc=belady ------------------------------- */
+
+/* Setup the use chains of all non-constant refs.
+**
+** The default eviction heuristic assumes that a value defined earlier
+** is needed later (going backwards). With regalloc=belady, the register
+** whose value has its nearest use before the current instruction furthest
+** away is evicted instead, i.e. Belady's rule applied to the backwards
+** pass. nextuse[] holds the last known use of each ref. It is lazily
+** moved backwards along prevuse[], so this costs O(uses) per trace.
+**
+** The chains live in J->usebuf, which is kept across traces like the
+** snapshot buffers. It can't be freed with the ASMState, since errors
+** unwind past it.
+*/
+static void ra_setup_belady(ASMState *as)
+{
+  jit_State *J = as->J;
+  IRRef ref, nins = as->orignins;
+  MSize n = nins - REF_BIAS;
+  IRRef1 *last, *prev;
+  if (3*n > J->sizeuse) {
+    lj_mem_reallocvec(J->L, J->usebuf, J->sizeuse, 3*n, IRRef1);
+    J->sizeuse = 3*n;
+  }
+  last = J->usebuf;
+  prev = last + n;
+  for (ref = REF_BIAS; ref < nins; ref++)
+    last[ref-REF_BIAS] = (IRRef1)ref;  /* Chains end at the definition. */
+  prev[0] = prev[1] = 0;
+  for (ref = REF_FIRST; ref < nins; ref++) {
+    IRIns *ir = IR(ref);
+    uint32_t mode = lj_ir_mode[ir->o];
+    IRRef1 *p = &prev[(ref-REF_BIAS)*2];
+    p[0] = p[1] = 0;
+    if (irm_op1(mode) == IRMref && ir->op1 >= REF_BIAS) {
+      p[0] = last[ir->op1-REF_BIAS];
+      last[ir->op1-REF_BIAS] = (IRRef1)ref;
+    }
+    if (irm_op2(mode) == IRMref && ir->op2 >= REF_BIAS && ir->op2 != ir->op1) {
+      p[1] = last[ir->op2-REF_BIAS];
+      last[ir->op2-REF_BIAS] = (IRRef1)ref;
+    }
+  }
+  as->nextuse = last;
+  as->prevuse = prev;
+}
+
+/* Get the nearest use of a ref at or before the current instruction. */
+static IRRef ra_nextuse(ASMState *as, IRRef ref)
+{
+  IRRef1 *pu = &as->nextuse[ref-REF_BIAS];
+  IRRef use = *pu;
+  while (use > as->curins && use != ref)
+    use = as->prevuse[(use-REF_BIAS)*2 + (IR(use)->op1 != ref)];
+  *pu = (IRRef1)use;
+  return use;
+}
+
+/* Pick the ref to evict for regalloc=belady. */
+static IRRef ra_evictref_belady(ASMState *as, RegSet allow)
+{
+  RegCost cost = ~(RegCost)0;
+  RegSet work = allow & ~as->freeset &
+    ((RID_NUM_FPR == 0 || allow < RID2RSET(RID_MAX_GPR)) ? RSET_GPR : RSET_FPR);
+  while (work) {
+    Reg r = rset_pickbot(work);
+    IRRef ref = regcost_ref(as->cost[r]);
+    RegCost c = as->cost[r];
+    if (!irref_isk(ref) && ref < as->orignins)
+      c = REGCOST(ra_nextuse(as, ref), ref) + REGCOST_T(irt_t(IR(ref)->t));
+    if (c < cost) cost = c;
+    rset_clear(work, r);
+  }
+  return regcost_ref(cost);
+}
+
 #define MINCOST(name) \
   if (rset_test(RSET_ALL, RID_##name) && \
       LJ_LIKELY(allow&RID2RSET(RID_##name)) && as->cost[RID_##name] < cost) \
@@ -453,12 +535,16 @@ static Reg ra_evict(ASMState *as, RegSet allow)
   IRRef ref;
   RegCost cost = ~(RegCost)0;
   lj_assertA(allow != RSET_EMPTY, "evict from empty set");
-  if (RID_NUM_FPR == 0 || allow < RID2RSET(RID_MAX_GPR)) {
-    GPRDEF(MINCOST)
+  if (as->nextuse) {
+    ref = ra_evictref_belady(as, allow);
   } else {
-    FPRDEF(MINCOST)
+    if (RID_NUM_FPR == 0 || allow < RID2RSET(RID_MAX_GPR)) {
+      GPRDEF(MINCOST)
+    } else {
+      FPRDEF(MINCOST)
+    }
+    ref = regcost_ref(cost);
   }
-  ref = regcost_ref(cost);
   lj_assertA(ra_iskref(ref) || (ref >= as->T->nk && ref < as->T->nins),
 	     "evict of out-of-range IR %04d", ref - REF_BIAS);
   /* Preferably pick any weak ref instead of a non-weak, non-const ref. */
@@ -1565,6 +1651,9 @@ static void asm_phi(ASMState *as, IRIns *ir)
 }
 
 static void asm_loop_fixup(ASMState *as);
+#if LJ_TARGET_X64
+static void asm_loop_vec(ASMState *as);
+#endif
 
 /* Middle part of a loop. */
 static void asm_loop(ASMState *as)
@@ -1587,6 +1676,9 @@ static void asm_loop(ASMState *as)
   if (!as->realign) RA_DBG_FLUSH();
   if (as->mcp != mcspill)
     emit_jmp(as, mcspill);
+#if LJ_TARGET_X64
+  asm_loop_vec(as);
+#endif
 }
 
 /* -- Target-specific assembler ------------------------------------------- */
@@ -2404,9 +2496,13 @@ void lj_asm_trace(jit_State *J, GCtrace *T)
     as->flagmcp = NULL;
     as->topslot = 0;
     as->gcsteps = 0;
+    as->nspill = 0;
     as->sectref = as->loopref;
     as->fuseref = (as->flags & JIT_F_OPT_FUSE) ? as->loopref : FUSE_DISABLED;
     asm_setup_regsp(as);
+    as->nextuse = NULL;
+    if (J->param[JIT_P_regalloc] == JIT_RA_BELADY)
+      ra_setup_belady(as);
     if (!as->loopref)
       asm_tail_link(as);
 
@@ -2471,6 +2567,7 @@ void lj_asm_trace(jit_State *J, GCtrace *T)
   if (!as->loopref)
     asm_tail_fixup(as, T->link);  /* Note: this may change as->mctop! */
   T->szmcode = (MSize)((char *)as->mctop - (char *)as->mcp);
+  T->nspill = as->nspill < 0xffff ? (uint16_t)as->nspill : 0xffff;
 #if LJ_TARGET_MCODE_FIXUP
   asm_mcode_fixup(T->mcode, T->szmcode);
 #endif
@@ -150,7 +150,8 @@ static int32_t asm_fuseabase(ASMState *as, IRRef ref)
 {
   IRIns *ir = IR(ref);
   if (ir->o == IR_TNEW && ir->op1 <= LJ_MAX_COLOSIZE &&
-      !neverfuse(as) && noconflict(as, ref, IR_NEWREF))
+      !neverfuse(as) && noconflict(as, ref, IR_NEWREF) &&
+      noconflict(as, ref, IR_CALLS))  /* May move the array. */
     return (int32_t)sizeof(GCtab);
   return 0;
 }
@@ -898,6 +899,11 @@ static void asm_hrefk(ASMState *as, IRIns *ir)
   } else if (ra_hasreg(dest)) {
     emit_opk(as, A64I_ADDx, dest, node, ofs, allow);
   }
+  if (!irt_isguard(ir->t)) {  /* Key already known to be in this slot. */
+    if (bigofs)
+      emit_opk(as, A64I_ADDx, dest, node, ofs, RSET_GPR);
+    return;
+  }
   asm_guardcc(as, CC_NE);
   if (irt_ispri(irkey->t)) {
     k = ~((int64_t)~irt_toitype(irkey->t) << 47);
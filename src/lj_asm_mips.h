@@ -137,7 +137,8 @@ static int32_t asm_fuseabase(ASMState *as, IRRef ref)
 {
   IRIns *ir = IR(ref);
   if (ir->o == IR_TNEW && ir->op1 <= LJ_MAX_COLOSIZE &&
-      !neverfuse(as) && noconflict(as, ref, IR_NEWREF))
+      !neverfuse(as) && noconflict(as, ref, IR_NEWREF) &&
+      noconflict(as, ref, IR_CALLS))  /* May move the array. */
     return (int32_t)sizeof(GCtab);
   return 0;
 }
@@ -1106,7 +1107,7 @@ static void asm_hrefk(ASMState *as, IRIns *ir)
   Reg key = RID_NONE, type = RID_TMP;
   int32_t lo, hi;
 #else
-  Reg key = ra_scratch(as, allow);
+  Reg key;
   int64_t k;
 #endif
   lj_assertA(ofs % sizeof(Node) == 0, "unaligned HREFK slot");
@@ -1117,6 +1118,11 @@ static void asm_hrefk(ASMState *as, IRIns *ir)
   } else if (ra_hasreg(dest)) {
     emit_tsi(as, MIPSI_AADDIU, dest, node, ofs);
   }
+  if (!irt_isguard(ir->t)) {  /* Key already known to be in this slot. */
+    if (ofs > 32736)
+      emit_tsi(as, MIPSI_AADDU, dest, node, ra_allock(as, ofs, allow));
+    return;
+  }
 #if LJ_32
   if (!irt_ispri(irkey->t)) {
     key = ra_scratch(as, allow);
@@ -1145,6 +1151,8 @@ nolo:
   } else {
     k = ((int64_t)irt_toitype(irkey->t) << 47) | (int64_t)ir_kgc(irkey);
   }
+  key = ra_scratch(as, allow);
+  rset_clear(allow, key);
   asm_guard(as, MIPSI_BNE, key, ra_allock(as, k, allow));
   emit_tsi(as, MIPSI_LD, key, idx, kofs);
 #endif
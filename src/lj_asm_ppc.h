@@ -104,7 +104,8 @@ static int32_t asm_fuseabase(ASMState *as, IRRef ref)
 {
   IRIns *ir = IR(ref);
   if (ir->o == IR_TNEW && ir->op1 <= LJ_MAX_COLOSIZE &&
-      !neverfuse(as) && noconflict(as, ref, IR_NEWREF))
+      !neverfuse(as) && noconflict(as, ref, IR_NEWREF) &&
+      noconflict(as, ref, IR_CALLS))  /* May move the array. */
     return (int32_t)sizeof(GCtab);
   return 0;
 }
@@ -769,6 +770,13 @@ static void asm_hrefk(ASMState *as, IRIns *ir)
   } else if (ra_hasreg(dest)) {
     emit_tai(as, PPCI_ADDI, dest, node, ofs);
   }
+  if (!irt_isguard(ir->t)) {  /* Key already known to be in this slot. */
+    if (ofs > 32736) {
+      emit_tai(as, PPCI_ADDIS, dest, dest, (ofs + 32768) >> 16);
+      emit_tai(as, PPCI_ADDI, dest, node, ofs);
+    }
+    return;
+  }
   asm_guardcc(as, CC_NE);
   if (!irt_ispri(irkey->t)) {
     key = ra_scratch(as, allow);
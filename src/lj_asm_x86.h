@@ -134,7 +134,8 @@ static IRRef asm_fuseabase(ASMState *as, IRRef ref)
     lj_assertA(irb->op2 == IRFL_TAB_ARRAY, "expected FLOAD TAB_ARRAY");
     /* We can avoid the FLOAD of t->array for colocated arrays. */
     if (ira->o == IR_TNEW && ira->op1 <= LJ_MAX_COLOSIZE &&
-	!neverfuse(as) && noconflict(as, irb->op1, IR_NEWREF, 1)) {
+	!neverfuse(as) && noconflict(as, irb->op1, IR_NEWREF, 1) &&
+	noconflict(as, irb->op1, IR_CALLS, 1)) {  /* May move the array. */
       as->mrm.ofs = (int32_t)sizeof(GCtab);  /* Ofs to colocated array. */
       return irb->op1;  /* Table obj. */
     }
@@ -218,7 +219,7 @@ static void asm_fuseahuref(ASMState *as, IRRef ref, RegSet allow)
       break;
     default:
       lj_assertA(ir->o == IR_HREF || ir->o == IR_NEWREF || ir->o == IR_UREFO ||
-		 ir->o == IR_KKPTR,
+		 ir->o == IR_KKPTR || ir->o == IR_CALLL,
 		 "bad IR op %d", ir->o);
       break;
     }
@@ -648,10 +649,53 @@ static void asm_gencall(ASMState *as, const CCallInfo *ci, IRRef *args)
 }
 
 /* Setup result reg/sp for call. Evict scratch regs. */
+#if LJ_64 && LJ_HASFFI
+/* Setup results of a call returning a small struct in two registers. */
+static void asm_setupresult2(ASMState *as, IRIns *ir)
+{
+  IRIns *irh = ir+1;
+  Reg rlo = irt_isfp(ir->t) ? RID_FPRET : RID_RET;
+  Reg rhi = irt_isfp(irh->t) ? (irt_isfp(ir->t) ? RID_XMM1 : RID_FPRET) :
+			       (irt_isfp(ir->t) ? RID_RET : RID_EDX);
+  Reg destlo = ir->r, desthi = irh->r;
+  if (ra_hasreg(destlo)) {
+    ra_free(as, destlo);
+    ra_modified(as, destlo);
+  } else {
+    destlo = rlo;
+  }
+  if (ra_hasreg(desthi)) {
+    ra_free(as, desthi);
+    ra_modified(as, desthi);
+  } else {
+    desthi = rhi;
+  }
+  /* Note: the moves are emitted backwards. */
+  if (destlo == rhi && desthi == rlo) {  /* Swap via a free register. */
+    RegSet allow = irt_isfp(ir->t) ? RSET_FPR : RSET_GPR;
+    Reg tmp = rset_pickbot(as->freeset & allow &
+			   ~(RID2RSET(rlo) | RID2RSET(rhi)));
+    emit_movrr(as, ir, destlo, tmp);
+    emit_movrr(as, irh, desthi, rhi);
+    emit_movrr(as, ir, tmp, rlo);
+  } else if (destlo == rhi) {  /* Move hiword out of the way first. */
+    if (destlo != rlo) emit_movrr(as, ir, destlo, rlo);
+    if (desthi != rhi) emit_movrr(as, irh, desthi, rhi);
+  } else {
+    if (desthi != rhi) emit_movrr(as, irh, desthi, rhi);
+    if (destlo != rlo) emit_movrr(as, ir, destlo, rlo);
+  }
+  /* Restore spill slots (if any). */
+  if (ra_hasspill(irh->s)) ra_save(as, irh, rhi);
+  if (ra_hasspill(ir->s)) ra_save(as, ir, rlo);
+}
+#endif
+
 static void asm_setupresult(ASMState *as, IRIns *ir, const CCallInfo *ci)
 {
   RegSet drop = RSET_SCRATCH;
-  int hiop = (LJ_32 && (ir+1)->o == IR_HIOP && !irt_isnil((ir+1)->t));
+  int hiop = ((LJ_32 || LJ_HASFFI) && (ir+1)->o == IR_HIOP &&
+	      !irt_isnil((ir+1)->t));
   if ((ci->flags & CCI_NOFPRCLOBBER))
     drop &= ~RSET_FPR;
   if (ra_hasreg(ir->r))
@@ -659,6 +703,12 @@ static void asm_setupresult(ASMState *as, IRIns *ir, const CCallInfo *ci)
   if (hiop && ra_hasreg((ir+1)->r))
     rset_clear(drop, (ir+1)->r);  /* Dest reg handled below. */
   ra_evictset(as, drop);  /* Evictions must be performed first. */
+#if LJ_64 && LJ_HASFFI
+  if (hiop) {
+    asm_setupresult2(as, ir);
+    return;
+  }
+#endif
   if (ra_used(ir)) {
     if (irt_isfp(ir->t)) {
       int32_t ofs = sps_scale(ir->s);  /* Use spill slot or temp slots. */
@@ -1290,6 +1340,8 @@ static void asm_hrefk(ASMState *as, IRIns *ir)
       emit_rr(as, XO_MOV, dest|REX_GC64, node);
     }
   }
+  if (!irt_isguard(ir->t))
+    return;  /* Key already known to be in this slot. */
   asm_guardcc(as, CC_NE);
 #if LJ_64
   if (!irt_ispri(irkey->t)) {
@@ -2640,8 +2692,12 @@ static void asm_hiop(ASMState *as, IRIns *ir)
     break;
   default: lj_assertA(0, "bad HIOP for op %d", (ir-1)->o); break;
   }
+#elif LJ_HASFFI
+  /* x64: second result of a call returning a small struct. */
+  lj_assertA((ir-1)->o == IR_CALLXS, "bad HIOP for op %d", (ir-1)->o);
+  UNUSED(as);  /* Handled by asm_setupresult(). */
 #else
-  /* Unused on x64 or without FFI. */
+  /* Unused without FFI. */
   UNUSED(as); UNUSED(ir); lj_assertA(0, "unexpected HIOP");
 #endif
 }
@@ -2788,6 +2844,414 @@ static void asm_gc_check(ASMState *as)
   as->gcsteps = 0;
   checkmclim(as);
 }
+
+/* -- Loop vectorization -------------------------------------------------- */
+
+#if LJ_64
+/*
+** Simple counted loops over FFI arrays, e.g. for i=0,n-1 do a[i]=b[i]*k end,
+** get a packed SSE2 pre-loop on loop entry. It processes one vector worth
+** of iterations at a time, as long as the scalar loop has at least one more
+** iteration to go. Then it falls through to the scalar loop, which does the
+** remaining iterations and takes all exits, so no snapshot is affected.
+**
+** The loop body may only contain the loop index increment and exit check,
+** stride-1 XLOAD/XSTOREs of num or int elements and lane-wise arithmetic
+** on these and loop invariants. Arrays with different bases are checked
+** for overlap at runtime and the scalar loop is used if they do.
+*/
+
+#define VEC_BYTES	16	/* Vector width in bytes. */
+#define VEC_MAXINS	48	/* Max. # of instructions in the loop body. */
+#define VEC_MAXMEM	8	/* Max. # of memory references. */
+#define VEC_MAXINV	8	/* Max. # of loop invariant operands. */
+
+typedef struct VecState {
+  IRRef idx;		/* Loop index, i.e. the left PHI operand. */
+  IRRef stop;		/* Loop limit. */
+  int cc;		/* Condition code to leave the vector loop. */
+  IRType t;		/* Element type: IRT_NUM or IRT_INT. */
+  int shift;		/* log2 of the element size. */
+  MSize nmem, ninv;
+  IRRef1 mem[VEC_MAXMEM];	/* XLOAD/XSTORE references. */
+  IRRef1 base[VEC_MAXMEM];	/* Base pointer of each memory reference. */
+  int32_t ofs[VEC_MAXMEM];	/* Constant offset of each memory reference. */
+  Reg basereg[VEC_MAXMEM];	/* Register holding the base pointer. */
+  IRRef1 inv[VEC_MAXINV];	/* Loop invariant operands. */
+  Reg invreg[VEC_MAXINV];	/* Register holding the broadcast invariant. */
+  uint8_t uses[VEC_MAXINS];	/* Remaining uses of each vector value. */
+  Reg vreg[VEC_MAXINS];		/* Register of each vector value. */
+  uint8_t copy[VEC_MAXINS];	/* Need to copy the left operand first. */
+  RegSet modset;		/* Registers modified by the pre-loop. */
+} VecState;
+
+/* Check for a stride-1 address [base+idx*size+ofs]. */
+static int asm_vec_addr(ASMState *as, VecState *vs, IRRef ref, MSize m)
+{
+  IRIns *ir = IR(ref);
+  IRRef b;
+  vs->ofs[m] = 0;
+  if (ir->o == IR_ADD && irref_isk(ir->op2)) {
+    IRIns *irk = IR(ir->op2);
+    int64_t k = irk->o == IR_KINT64 ? (int64_t)ir_kint64(irk)->u64 :
+		irk->o == IR_KINT ? irk->i : INT64_MAX;
+    if (k < -0x40000000 || k > 0x40000000) return 0;
+    vs->ofs[m] = (int32_t)k;
+    ir = IR(ir->op1);
+  }
+  if (ir->o != IR_ADD || !irt_is64(ir->t) || irt_isnum(ir->t)) return 0;
+  b = ir->op2;
+  if (IR(ir->op1)->o != IR_BSHL) {
+    b = ir->op1;
+    ir = IR(ir->op2);
+  } else {
+    ir = IR(ir->op1);
+  }
+  if (ir->o != IR_BSHL || ir->op1 != vs->idx || !irref_isk(ir->op2) ||
+      IR(ir->op2)->o != IR_KINT || IR(ir->op2)->i != vs->shift)
+    return 0;
+  if (irref_isk(b) ? IR(b)->o != IR_KINT64 : b >= as->loopref)
+    return 0;
+  vs->base[m] = (IRRef1)b;
+  return 1;
+}
+
+/* Check a vector operand and add loop invariants to the broadcast list. */
+static int asm_vec_operand(ASMState *as, VecState *vs, IRRef ref)
+{
+  IRIns *ir = IR(ref);
+  if (ref > as->loopref) {
+    return vs->vreg[ref - as->loopref] == RID_NONE;
+  } else if (irref_isk(ref) ? ir->o == (vs->t == IRT_NUM ? IR_KNUM : IR_KINT) :
+	     ref != vs->idx && irt_type(ir->t) == vs->t) {
+    MSize i;
+    for (i = 0; i < vs->ninv; i++)
+      if (vs->inv[i] == ref) return 1;
+    if (vs->ninv == VEC_MAXINV) return 0;
+    vs->inv[vs->ninv++] = (IRRef1)ref;
+    return 1;
+  }
+  return 0;
+}
+
+/* Get the packed opcode for an arithmetic instruction. */
+static x86Op asm_vec_op(VecState *vs, IROp o)
+{
+  if (vs->t == IRT_NUM) {
+    switch (o) {
+    case IR_ADD: return XO_ADDPD;
+    case IR_SUB: return XO_SUBPD;
+    case IR_MUL: return XO_MULPD;
+    case IR_DIV: return XO_DIVPD;
+    default: break;
+    }
+  } else {
+    switch (o) {
+    case IR_ADD: return XO_PADDD;
+    case IR_SUB: return XO_PSUBD;
+    case IR_BAND: return XO_PAND;
+    case IR_BOR: return XO_POR;
+    case IR_BXOR: return XO_PXOR;
+    default: break;
+    }
+  }
+  return (x86Op)0;
+}
+
+/* Get the register of a vector operand. */
+static Reg asm_vec_reg(ASMState *as, VecState *vs, IRRef ref)
+{
+  MSize i;
+  if (ref > as->loopref) return vs->vreg[ref - as->loopref];
+  for (i = 0; vs->inv[i] != ref; i++) ;
+  return vs->invreg[i];
+}
+
+/* Analyze the loop body. Returns 0 if it cannot be vectorized. */
+static int asm_vec_analyze(ASMState *as, VecState *vs)
+{
+  IRRef loopref = as->loopref, nins = as->orignins, ref, inc;
+  IRIns *ir = IR(nins-1);
+  MSize m;
+  if (nins - loopref > VEC_MAXINS || ir->o != IR_PHI || IR(nins-2)->o == IR_PHI ||
+      !irt_isint(ir->t) || ra_hasspill(ir->s))
+    return 0;
+  vs->idx = ir->op1;
+  inc = ir->op2;
+  if (!ra_hasreg(IR(vs->idx)->r) || ra_hasspill(IR(vs->idx)->s) ||
+      IR(inc)->o != IR_ADD || IR(inc)->op1 != vs->idx ||
+      !irref_isk(IR(inc)->op2) || IR(IR(inc)->op2)->i != 1)
+    return 0;
+  /* Find the element type. */
+  vs->t = IRT_NIL;
+  for (ref = loopref+1; ref < nins; ref++) {
+    ir = IR(ref);
+    if (ir->o == IR_XLOAD || ir->o == IR_XSTORE) {
+      IRType t = irt_type(ir->o == IR_XLOAD ? ir->t : IR(ir->op2)->t);
+      if (t != IRT_NUM && t != IRT_INT) return 0;
+      vs->t = t;
+      vs->shift = t == IRT_NUM ? 3 : 2;
+      break;
+    }
+  }
+  if (vs->t == IRT_NIL) return 0;
+  /* Check all instructions. */
+  vs->stop = 0;
+  vs->nmem = vs->ninv = 0;
+  for (ref = loopref+1; ref < nins-1; ref++) {
+    MSize k = ref - loopref;
+    ir = IR(ref);
+    vs->vreg[k] = RID_INIT;  /* Not a vector value. */
+    vs->uses[k] = 0;
+    if (ir->r == RID_SINK) return 0;
+    switch (ir->o) {
+    case IR_NOP: case IR_BSHL:
+      continue;
+    case IR_XLOAD: case IR_XSTORE:
+      if (vs->nmem == VEC_MAXMEM || !asm_vec_addr(as, vs, ir->op1, vs->nmem))
+	return 0;
+      vs->mem[vs->nmem++] = (IRRef1)ref;
+      if (ir->o == IR_XLOAD) {
+	if ((ir->op2 & IRXLOAD_VOLATILE) || irt_type(ir->t) != vs->t)
+	  return 0;
+	vs->vreg[k] = RID_NONE;
+      } else if (!asm_vec_operand(as, vs, ir->op2) ||
+		 (ir->op2 > loopref && irt_type(IR(ir->op2)->t) != vs->t)) {
+	return 0;
+      }
+      continue;
+    case IR_LE: case IR_LT:
+      if (ref != nins-2 || ir->op1 != inc || !irt_isint(IR(ir->op2)->t) ||
+	  ir->op2 == vs->idx || (!irref_isk(ir->op2) && ir->op2 >= loopref))
+	return 0;
+      vs->stop = ir->op2;
+      vs->cc = ir->o == IR_LE ? CC_G : CC_GE;
+      continue;
+    default:
+      break;
+    }
+    if (ref == inc) continue;
+    if (ir->o == IR_ADD && irt_is64(ir->t) && !irt_isnum(ir->t))
+      continue;  /* Address arithmetic, checked by asm_vec_addr. */
+    if (irt_isguard(ir->t) || irt_type(ir->t) != vs->t ||
+	!asm_vec_op(vs, (IROp)ir->o) ||
+	!asm_vec_operand(as, vs, ir->op1) || !asm_vec_operand(as, vs, ir->op2))
+      return 0;
+    vs->vreg[k] = RID_NONE;
+  }
+  if (!vs->stop) return 0;
+  /* Count the uses of all vector values. */
+  for (ref = loopref+1; ref < nins-1; ref++) {
+    ir = IR(ref);
+    if (vs->vreg[ref - loopref] == RID_NONE && ir->o != IR_XLOAD) {
+      if (ir->op1 > loopref) vs->uses[ir->op1 - loopref]++;
+      if (ir->op2 > loopref) vs->uses[ir->op2 - loopref]++;
+    } else if (ir->o == IR_XSTORE && ir->op2 > loopref) {
+      vs->uses[ir->op2 - loopref]++;
+    }
+  }
+  /* Memory references to the same base must not overlap within a vector. */
+  for (m = 0; m < vs->nmem; m++) {
+    MSize n;
+    if (IR(vs->mem[m])->o != IR_XSTORE) continue;
+    for (n = 0; n < vs->nmem; n++) {
+      int32_t d = vs->ofs[n] - vs->ofs[m];
+      if (n != m && vs->base[n] == vs->base[m] && d != 0 &&
+	  d > -VEC_BYTES && d < VEC_BYTES)
+	return 0;
+    }
+  }
+  return 1;
+}
+
+/* Assign registers to all vector values. Returns 0 if there are too few. */
+static int asm_vec_regalloc(ASMState *as, VecState *vs)
+{
+  RegSet fpr = as->freeset & RSET_FPR;
+  RegSet gpr = as->freeset & RSET_GPR & ~RID2RSET(RID_ESP);
+  IRRef ref, loopref = as->loopref;
+  MSize i;
+  IRIns *irs = IR(vs->stop);
+  if (!gpr || !(irref_isk(vs->stop) || ra_hasreg(irs->r) || ra_hasspill(irs->s)))
+    return 0;
+  vs->modset = RID2RSET(rset_pickbot(gpr)) | RID2RSET(IR(vs->idx)->r);
+  rset_clear(gpr, rset_pickbot(gpr));  /* Keep one GPR for temporaries. */
+  for (i = 0; i < vs->nmem; i++) {
+    IRIns *irb = IR(vs->base[i]);
+    MSize j;
+    for (j = 0; j < i; j++)
+      if (vs->base[j] == vs->base[i]) break;
+    if (j < i) {
+      vs->basereg[i] = vs->basereg[j];
+    } else if (!irref_isk(vs->base[i]) && ra_hasreg(irb->r)) {
+      vs->basereg[i] = irb->r;
+    } else if (gpr && (irref_isk(vs->base[i]) || ra_hasspill(irb->s))) {
+      vs->basereg[i] = rset_pickbot(gpr);
+      rset_clear(gpr, vs->basereg[i]);
+      rset_set(vs->modset, vs->basereg[i]);
+    } else {
+      return 0;
+    }
+  }
+  for (i = 0; i < vs->ninv; i++) {
+    IRIns *iri = IR(vs->inv[i]);
+    if (!fpr || !(irref_isk(vs->inv[i]) || ra_hasreg(iri->r) ||
+		  ra_hasspill(iri->s)))
+      return 0;
+    vs->invreg[i] = rset_pickbot(fpr);
+    rset_clear(fpr, vs->invreg[i]);
+    rset_set(vs->modset, vs->invreg[i]);
+  }
+  for (ref = loopref+1; ref < as->orignins-1; ref++) {
+    MSize k = ref - loopref;
+    IRIns *ir = IR(ref);
+    if (ir->o == IR_XSTORE) {
+      if (ir->op2 > loopref && --vs->uses[ir->op2 - loopref] == 0)
+	rset_set(fpr, vs->vreg[ir->op2 - loopref]);
+    } else if (vs->vreg[k] == RID_NONE) {
+      Reg r = RID_NONE;
+      vs->copy[k] = 1;
+      if (ir->o != IR_XLOAD && ir->op1 > loopref &&
+	  --vs->uses[ir->op1 - loopref] == 0) {
+	r = vs->vreg[ir->op1 - loopref];  /* Reuse the dying left operand. */
+	vs->copy[k] = 0;
+      }
+      if (r == RID_NONE) {
+	if (!fpr) return 0;
+	r = rset_pickbot(fpr);
+	rset_clear(fpr, r);
+	rset_set(vs->modset, r);
+      }
+      /* Free the right operand only after picking the destination. */
+      if (ir->o != IR_XLOAD && ir->op2 > loopref &&
+	  --vs->uses[ir->op2 - loopref] == 0 && vs->vreg[ir->op2 - loopref] != r)
+	rset_set(fpr, vs->vreg[ir->op2 - loopref]);
+      vs->vreg[k] = r;
+      if (vs->uses[k] == 0) rset_set(fpr, r);
+    }
+  }
+  return 1;
+}
+
+/* Load a loop invariant operand and broadcast it to all lanes. */
+static void asm_vec_broadcast(ASMState *as, VecState *vs, IRRef ref, Reg r,
+			      Reg tmp)
+{
+  IRIns *ir = IR(ref);
+  if (vs->t == IRT_NUM) {
+    emit_rr(as, XO_UNPCKLPD, r, r);
+    if (irref_isk(ref))
+      emit_loadk64(as, r, ir);
+    else if (ra_hasreg(ir->r))
+      emit_rr(as, XO_MOVAPS, r, ir->r);
+    else
+      emit_rmro(as, XO_MOVSD, r, RID_ESP, sps_scale(ir->s));
+  } else {
+    emit_i8(as, 0);
+    emit_rr(as, XO_PSHUFD, r, r);
+    if (irref_isk(ref)) {
+      emit_rr(as, XO_MOVD, r, tmp);
+      emit_loadi(as, tmp, ir->i);
+    } else if (ra_hasreg(ir->r)) {
+      emit_rr(as, XO_MOVD, r, ir->r);
+    } else {
+      emit_rmro(as, XO_MOVD, r, RID_ESP, sps_scale(ir->s));
+    }
+  }
+}
+
+/* Emit the vector pre-loop on loop entry. */
+static void asm_loop_vec(ASMState *as)
+{
+  VecState vs;
+  MCode *scalar = as->mcp, *vloop, *pjmp;
+  IRRef loopref = as->loopref, ref;
+  Reg ridx, tmp;
+  x86Mode scale;
+  MSize i, j;
+  if (!as->J->param[JIT_P_vectorize] || !asm_vec_analyze(as, &vs) ||
+      !asm_vec_regalloc(as, &vs))
+    return;
+  ridx = IR(vs.idx)->r;
+  tmp = rset_pickbot(as->freeset & RSET_GPR & ~RID2RSET(RID_ESP));
+  scale = (x86Mode)(vs.shift << 6);
+  /* Loop back to the check and advance the index by one vector. */
+  emit_jmp(as, scalar);
+  pjmp = as->mcp;
+  emit_gri(as, XG_ARITHi(XOg_ADD), ridx, VEC_BYTES >> vs.shift);
+  for (ref = as->orignins-2; ref > loopref; ref--) {
+    IRIns *ir = IR(ref);
+    MSize k = ref - loopref;
+    if (ir->o == IR_XLOAD || ir->o == IR_XSTORE) {
+      for (i = 0; vs.mem[i] != ref; i++) ;
+      if (ir->o == IR_XLOAD)
+	emit_rmrxo(as, XO_MOVUPS, vs.vreg[k], vs.basereg[i], ridx, scale,
+		   vs.ofs[i]);
+      else
+	emit_rmrxo(as, XO_MOVUPSto, asm_vec_reg(as, &vs, ir->op2),
+		   vs.basereg[i], ridx, scale, vs.ofs[i]);
+    } else if (vs.vreg[k] != RID_INIT) {
+      emit_rr(as, asm_vec_op(&vs, (IROp)ir->o), vs.vreg[k],
+	      asm_vec_reg(as, &vs, ir->op2));
+      if (vs.copy[k])
+	emit_rr(as, XO_MOVAPS, vs.vreg[k], asm_vec_reg(as, &vs, ir->op1));
+    }
+    checkmclim(as);
+  }
+  /* Stay in the vector loop while the scalar loop has iterations left. */
+  emit_jcc(as, vs.cc, scalar);
+  if (irref_isk(vs.stop))
+    emit_gri(as, XG_ARITHi(XOg_CMP), tmp, IR(vs.stop)->i);
+  else if (ra_hasreg(IR(vs.stop)->r))
+    emit_rr(as, XO_CMP, tmp, IR(vs.stop)->r);
+  else
+    emit_rmro(as, XO_CMP, tmp, RID_ESP, sps_scale(IR(vs.stop)->s));
+  emit_jcc(as, CC_O, scalar);
+  emit_gri(as, XG_ARITHi(XOg_ADD), tmp, VEC_BYTES >> vs.shift);
+  emit_rr(as, XO_MOV, tmp, ridx);
+  vloop = as->mcp;
+  *(int32_t *)(pjmp+1) = jmprel(as->J, pjmp+5, vloop);
+  /* Broadcast the loop invariants. */
+  for (i = 0; i < vs.ninv; i++) {
+    asm_vec_broadcast(as, &vs, vs.inv[i], vs.invreg[i], tmp);
+    checkmclim(as);
+  }
+  /* Use the scalar loop if different arrays overlap within a vector. */
+  for (i = 0; i < vs.nmem; i++) {
+    if (IR(vs.mem[i])->o != IR_XSTORE) continue;
+    for (j = 0; j < vs.nmem; j++) {
+      MCLabel l_ok;
+      if (vs.base[j] == vs.base[i]) continue;
+      l_ok = emit_label(as);
+      emit_jcc(as, CC_BE, scalar);
+      emit_gri(as, XG_ARITHi(XOg_CMP), tmp|REX_64, 2*(VEC_BYTES-1));
+      emit_gri(as, XG_ARITHi(XOg_ADD), tmp|REX_64, VEC_BYTES-1);
+      emit_sjcc(as, CC_Z, l_ok);
+      if (vs.ofs[j] != vs.ofs[i])
+	emit_gri(as, XG_ARITHi(XOg_ADD), tmp|REX_64, vs.ofs[j] - vs.ofs[i]);
+      emit_rr(as, XO_ARITH(XOg_SUB), tmp|REX_64, vs.basereg[i]);
+      emit_rr(as, XO_MOV, tmp|REX_64, vs.basereg[j]);
+      checkmclim(as);
+    }
+  }
+  /* Load base pointers which are not in a register. */
+  for (i = 0; i < vs.nmem; i++) {
+    IRIns *irb = IR(vs.base[i]);
+    for (j = 0; j < i; j++)
+      if (vs.base[j] == vs.base[i]) break;
+    if (j < i) continue;
+    if (irref_isk(vs.base[i]))
+      emit_loadu64(as, vs.basereg[i], ir_kint64(irb)->u64);
+    else if (vs.basereg[i] != irb->r)
+      emit_rmro(as, XO_MOV, vs.basereg[i]|REX_64, RID_ESP, sps_scale(irb->s));
+  }
+  /* Children must not inherit a BASE register clobbered as a temporary. */
+  as->modset |= vs.modset;
+  as->flagmcp = NULL;
+  checkmclim(as);
+}
+#endif
+
 /* -- Loop handling ------------------------------------------------------- */
 
 /* Fixup the loop branch. */
@@ -623,12 +623,6 @@ static int ccall_classify_struct(CTState *cts, CType *ct)
 
 #if LJ_TARGET_X64 && !LJ_ABI_WIN
 
-/* Register classes for x64 struct classification. */
-#define CCALL_RCL_INT	1
-#define CCALL_RCL_SSE	2
-#define CCALL_RCL_MEM	4
-/* NYI: classify vectors. */
-
 static int ccall_classify_struct(CTState *cts, CType *ct, int *rcl, CTSize ofs);
 
 /* Classify a C type. */
@@ -668,6 +662,13 @@ static int ccall_classify_struct(CTState *cts, CType *ct, int *rcl, CTSize ofs)
   return ((rcl[0]|rcl[1]) & CCALL_RCL_MEM);  /* Memory class? */
 }
 
+/* Classify a struct for the JIT compiler. Returns non-zero for memory class. */
+int lj_ccall_classify_struct(CTState *cts, CType *ct, int *rcl)
+{
+  rcl[0] = rcl[1] = 0;
+  return ccall_classify_struct(cts, ct, rcl, 0);
+}
+
 /* Try to split up a small struct into registers. */
 static int ccall_struct_reg(CCallState *cc, CTState *cts, GPRArg *dp, int *rcl)
 {
@@ -1147,6 +1148,192 @@ static int ccall_get_results(lua_State *L, CTState *cts, CType *ct,
   return lj_cconv_tv_ct(cts, ctr, 0, L->top-1, sp);
 }
 
+#if CCALL_HASSIG
+/* -- Cached call signatures ---------------------------------------------- */
+
+/* Argument and result conversion kinds. */
+enum {
+  CCARG_CONV,		/* Generic conversion via lj_cconv_*(). */
+  CCARG_I8, CCARG_U8, CCARG_I16, CCARG_U16, CCARG_I32, CCARG_U32,
+  CCARG_I64, CCARG_U64, CCARG_FLOAT, CCARG_DOUBLE, CCARG_PTR, CCARG_VOID
+};
+
+/* Get conversion kind for an argument or result type. */
+static uint8_t ccall_sig_kind(CType *d)
+{
+  CTInfo info = d->info;
+  if (ctype_isnum(info) && !ctype_isbool(info)) {
+    if (ctype_isfp(info)) {
+      if (d->size == sizeof(float)) return CCARG_FLOAT;
+      if (d->size == sizeof(double)) return CCARG_DOUBLE;
+    } else {
+      int uns = (info & CTF_UNSIGNED) ? 1 : 0;
+      switch (d->size) {
+      case 1: return CCARG_I8 + uns;
+      case 2: return CCARG_I16 + uns;
+      case 4: return CCARG_I32 + uns;
+      case 8: return CCARG_I64 + uns;
+      default: break;
+      }
+    }
+  } else if (ctype_isptr(info) && d->size == CTSIZE_PTR) {
+    return CCARG_PTR;
+  }
+  return CCARG_CONV;
+}
+
+/* Compute the argument layout for a C function type, if possible.
+** Only handles fixed numbers of scalar arguments and scalar results.
+** Mirrors the register and stack assignment of ccall_set_args().
+*/
+static void ccall_sig_init(CTState *cts, CType *ct, CCallSig *sig)
+{
+  CCallState ccs, *cc = &ccs;  /* Only used to compute slot offsets. */
+  CType *ctr = ctype_rawchild(cts, ct);
+  CTypeID fid;
+  MSize maxgpr = CCALL_NARG_GPR, ngpr = 0, nsp = 0, nfpr = 0, narg = 0;
+  sig->id = (CTypeID1)ctype_typeid(cts, ct);
+  sig->narg = CCALL_SIG_NONE;
+  if ((ct->info & CTF_VARARG) ||
+      !(ctype_isvoid(ctr->info) || ctype_isenum(ctr->info) ||
+	(ctype_isnum(ctr->info) && ctr->size <= 8) ||
+	(ctype_isptr(ctr->info) && ctr->size == CTSIZE_PTR)))
+    return;
+  sig->rkind = ctype_isvoid(ctr->info) ? CCARG_VOID : ccall_sig_kind(ctr);
+  if (LJ_DUALNUM && sig->rkind >= CCARG_I8 && sig->rkind <= CCARG_U32)
+    sig->rkind = CCARG_CONV;
+  sig->rid = (CTypeID1)ctype_typeid(cts, ctr);
+  for (fid = ct->sib; fid; ) {
+    CType *ctf = ctype_get(cts, fid);
+    CType *d;
+    MSize n = 1, isfp = 0;
+    void *dp;
+    fid = ctf->sib;
+    if (ctype_isattrib(ctf->info)) continue;
+    if (narg >= CCALL_SIG_NARG) return;
+    d = ctype_raw(cts, ctype_cid(ctf->info));
+    if (ctype_isnum(d->info)) {
+      if (d->size > 8) return;
+      isfp = (d->info & CTF_FP) ? 1 : 0;
+    } else if (!(ctype_isptr(d->info) || ctype_isenum(d->info))) {
+      return;  /* Aggregates, vectors and complex need the full setup. */
+    }
+
+    CCALL_HANDLE_REGARG  /* Handle register arguments. */
+
+    /* Otherwise pass argument on stack. */
+    if (nsp + n > CCALL_MAXSTACK) return;
+    dp = &cc->stack[nsp];
+    nsp += n;
+
+  done:
+    sig->arg[narg].kind = ccall_sig_kind(d);
+    sig->arg[narg].unused = 0;
+    sig->arg[narg].ofs = (uint16_t)((char *)dp - (char *)cc);
+    sig->arg[narg].id = (CTypeID1)ctype_typeid(cts, d);
+    narg++;
+  }
+  sig->nsp = (uint8_t)nsp;
+  sig->nfpr = (uint8_t)nfpr;
+  sig->narg = (uint8_t)narg;
+}
+
+/* Get the cached layout for a C function type or NULL if there is none. */
+static CCallSig *ccall_sig(CTState *cts, CType *ct)
+{
+  CTypeID id = ctype_typeid(cts, ct);
+  CCallSig *sig = cts->sig;
+  if (LJ_UNLIKELY(!sig)) {
+    sig = lj_mem_newvec(cts->L, CCALL_SIG_CACHE, CCallSig);
+    memset(sig, 0, CCALL_SIG_CACHE*sizeof(CCallSig));
+    cts->sig = sig;
+  }
+  sig += (id & (CCALL_SIG_CACHE-1));
+  if (LJ_UNLIKELY(sig->id != id))
+    ccall_sig_init(cts, ct, sig);
+  return sig->narg != CCALL_SIG_NONE ? sig : NULL;
+}
+
+/* Setup arguments for C call from a cached layout. */
+static void ccall_sig_args(lua_State *L, CTState *cts, CCallSig *sig,
+			   CCallState *cc)
+{
+  CCallSigArg *a = sig->arg, *ae = a + sig->narg;
+  TValue *o = L->base+1;
+  MSize nsp = sig->nsp;
+  for (; a < ae; a++, o++) {
+    uint8_t *dp = (uint8_t *)cc + a->ofs;
+    if (LJ_LIKELY(tvisnum(o))) {
+      lua_Number n = numV(o);
+      /* Same conversions as lj_cconv_ct_ct() and ccall_set_args(). */
+      switch (a->kind) {
+      case CCARG_I8: *(int32_t *)dp = (int8_t)(int32_t)n; continue;
+      case CCARG_U8: *(uint32_t *)dp = (uint8_t)(int32_t)n; continue;
+      case CCARG_I16: *(int32_t *)dp = (int16_t)(int32_t)n; continue;
+      case CCARG_U16: *(uint32_t *)dp = (uint16_t)(int32_t)n; continue;
+      case CCARG_I32: *(int32_t *)dp = (int32_t)n; continue;
+      case CCARG_U32: *(uint32_t *)dp = (uint32_t)n; continue;
+      case CCARG_I64: *(int64_t *)dp = (int64_t)n; continue;
+      case CCARG_U64: *(uint64_t *)dp = lj_num2u64(n); continue;
+      case CCARG_FLOAT: *(float *)dp = (float)n; continue;
+      case CCARG_DOUBLE: *(double *)dp = n; continue;
+      default: break;
+      }
+    } else if (a->kind == CCARG_PTR) {
+      if (tvisnil(o)) {
+	*(void **)dp = NULL;
+	continue;
+      } else if (tviscdata(o) && cdataV(o)->ctypeid == a->id) {
+	*(void **)dp = *(void **)cdataptr(cdataV(o));
+	continue;
+      }
+    }
+    {
+      CType *d = ctype_get(cts, a->id);
+      lj_cconv_ct_tv(cts, d, dp, o, CCF_ARG(a - sig->arg + 1));
+      /* Extend passed integers to 32 bits at least. */
+      if (ctype_isinteger_or_bool(d->info) && d->size < 4) {
+	if (d->info & CTF_UNSIGNED)
+	  *(uint32_t *)dp = d->size == 1 ? (uint32_t)*(uint8_t *)dp :
+					   (uint32_t)*(uint16_t *)dp;
+	else
+	  *(int32_t *)dp = d->size == 1 ? (int32_t)*(int8_t *)dp :
+					  (int32_t)*(int16_t *)dp;
+      }
+    }
+  }
+  cc->nfpr = sig->nfpr;  /* Required for vararg functions. */
+  cc->nsp = (uint8_t)nsp;
+  cc->spadj = (CCALL_SPS_FREE + CCALL_SPS_EXTRA)*CTSIZE_PTR;
+  if (nsp > CCALL_SPS_FREE)
+    cc->spadj += (((nsp-CCALL_SPS_FREE)*CTSIZE_PTR + 15u) & ~15u);
+}
+
+/* Get results from C call with a cached layout.
+** Note: a callback may have replaced the cache entry, so pass a copy.
+*/
+static int ccall_sig_results(lua_State *L, CTState *cts, uint32_t rkind,
+			     CTypeID rid, CCallState *cc, int *ret)
+{
+  TValue *o = L->top-1;
+  uint8_t *sp = (uint8_t *)&cc->gpr[0];
+  *ret = 1;  /* One result. */
+  switch (rkind) {
+  case CCARG_VOID: *ret = 0; return 0;
+  case CCARG_I8: setnumV(o, (lua_Number)*(int8_t *)sp); return 0;
+  case CCARG_U8: setnumV(o, (lua_Number)*(uint8_t *)sp); return 0;
+  case CCARG_I16: setnumV(o, (lua_Number)*(int16_t *)sp); return 0;
+  case CCARG_U16: setnumV(o, (lua_Number)*(uint16_t *)sp); return 0;
+  case CCARG_I32: setnumV(o, (lua_Number)*(int32_t *)sp); return 0;
+  case CCARG_U32: setnumV(o, (lua_Number)*(uint32_t *)sp); return 0;
+  case CCARG_FLOAT: setnumV(o, (lua_Number)cc->fpr[0].f[0]); return 0;
+  case CCARG_DOUBLE: setnumV(o, cc->fpr[0].d[0]); return 0;
+  default:
+    return lj_cconv_tv_ct(cts, ctype_get(cts, rid), 0, o, sp);
+  }
+}
+#endif
+
 /* Call C function. */
 int lj_ccall_func(lua_State *L, GCcdata *cd)
 {
@@ -1160,6 +1347,25 @@ int lj_ccall_func(lua_State *L, GCcdata *cd)
   if (ctype_isfunc(ct->info)) {
     CCallState cc;
     int gcsteps, ret;
+#if CCALL_HASSIG
+    CCallSig *sig = ccall_sig(cts, ct);
+    if (sig && L->top - (L->base+1) == (ptrdiff_t)sig->narg) {
+      uint32_t rkind = sig->rkind;
+      CTypeID rid = sig->rid;
+      cc.func = (void (*)(void))cdata_getptr(cdataptr(cd), sz);
+      ccall_sig_args(L, cts, sig, &cc);
+      cts->cb.slot = ~0u;
+      lj_vm_ffi_call(&cc);
+      if (cts->cb.slot != ~0u) {  /* Blacklist function that called a callback. */
+	TValue tv;
+	setlightudV(&tv, (void *)cc.func);
+	setboolV(lj_tab_set(L, cts->miscmap, &tv), 1);
+      }
+      if (ccall_sig_results(L, cts, rkind, rid, &cc, &ret))
+	lj_gc_check(L);
+      return ret;
+    }
+#endif
     cc.func = (void (*)(void))cdata_getptr(cdataptr(cd), sz);
     gcsteps = ccall_set_args(L, cts, ct, &cc);
     ct = (CType *)((intptr_t)ct-(intptr_t)cts->tab);
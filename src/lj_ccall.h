@@ -154,6 +154,9 @@ LJ_STATIC_ASSERT(CCALL_NUM_FPR <= CCALL_MAX_FPR);
 
 #define CCALL_MAXSTACK		32
 
+/* Cache argument layouts of C function types for calls from the VM. */
+#define CCALL_HASSIG		LJ_TARGET_X64
+
 /* -- C call state -------------------------------------------------------- */
 
 typedef LJ_ALIGN(CCALL_ALIGN_CALLSTATE) struct CCallState {
@@ -189,6 +192,16 @@ LJ_ASMF void LJ_FASTCALL lj_vm_ffi_call(CCallState *cc);
 LJ_FUNC CTypeID lj_ccall_ctid_vararg(CTState *cts, cTValue *o);
 LJ_FUNC int lj_ccall_func(lua_State *L, GCcdata *cd);
 
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+/* Register classes for x64 struct classification. */
+#define CCALL_RCL_INT	1
+#define CCALL_RCL_SSE	2
+#define CCALL_RCL_MEM	4
+/* NYI: classify vectors. */
+
+LJ_FUNC int lj_ccall_classify_struct(CTState *cts, CType *ct, int *rcl);
+#endif
+
 #endif
 
 #endif
@@ -515,18 +515,42 @@ void lj_ccallback_mcode_free(CTState *cts)
 #error "Missing calling convention definitions for this architecture"
 #endif
 
-/* Convert and push callback arguments to Lua stack. */
-static void callback_conv_args(CTState *cts, lua_State *L)
+/* Argument conversion kinds. */
+enum {
+  CBARG_CONV,		/* Generic conversion via lj_cconv_tv_ct(). */
+  CBARG_I8, CBARG_U8, CBARG_I16, CBARG_U16, CBARG_I32, CBARG_U32,
+  CBARG_FLOAT, CBARG_DOUBLE, CBARG_BOOL8, CBARG_BOOL32,
+  CBARG_STACK = 0x80	/* Flag: argument is passed on the stack. */
+};
+
+/* Get conversion kind for a callback argument type. */
+static uint8_t callback_argkind(CType *cta)
 {
-  TValue *o = L->top;
-  intptr_t *stack = cts->cb.stack;
-  MSize slot = cts->cb.slot;
-  CTypeID id = 0, rid, fid;
-  int gcsteps = 0;
-  CType *ct;
-  GCfunc *fn;
-  int fntp;
-  MSize ngpr = 0, nsp = 0, maxgpr = CCALL_NARG_GPR;
+  CTInfo info = cta->info;
+  if (ctype_isnum(info)) {
+    if (ctype_isbool(info))
+      return cta->size == 1 ? CBARG_BOOL8 : CBARG_BOOL32;
+    if (ctype_isfp(info)) {
+      if (cta->size == sizeof(float)) return CBARG_FLOAT;
+      if (cta->size == sizeof(double)) return CBARG_DOUBLE;
+    } else if (ctype_isinteger(info)) {
+      int uns = (info & CTF_UNSIGNED) ? 1 : 0;
+      switch (cta->size) {
+      case 1: return CBARG_I8 + uns;
+      case 2: return CBARG_I16 + uns;
+      case 4: return CBARG_I32 + uns;
+      default: break;
+      }
+    }
+  }
+  return CBARG_CONV;
+}
+
+/* Compute argument layout and conversions for a callback signature. */
+static void callback_sig_init(CTState *cts, CType *ct, CCallbackSig *sig)
+{
+  CTypeID fid;
+  MSize ngpr = 0, nsp = 0, maxgpr = CCALL_NARG_GPR, narg = 0;
 #if CCALL_NARG_FPR
   MSize nfpr = 0;
 #if LJ_TARGET_ARM
@@ -534,37 +558,6 @@ static void callback_conv_args(CTState *cts, lua_State *L)
 #endif
 #endif
 
-  if (slot < cts->cb.sizeid && (id = cts->cb.cbid[slot]) != 0) {
-    ct = ctype_get(cts, id);
-    rid = ctype_cid(ct->info);  /* Return type. x86: +(spadj<<16). */
-    fn = funcV(lj_tab_getint(cts->miscmap, (int32_t)slot));
-    fntp = LJ_TFUNC;
-  } else {  /* Must set up frame first, before throwing the error. */
-    ct = NULL;
-    rid = 0;
-    fn = (GCfunc *)L;
-    fntp = LJ_TTHREAD;
-  }
-  /* Continuation returns from callback. */
-  if (LJ_FR2) {
-    (o++)->u64 = LJ_CONT_FFI_CALLBACK;
-    (o++)->u64 = rid;
-    o++;
-  } else {
-    o->u32.lo = LJ_CONT_FFI_CALLBACK;
-    o->u32.hi = rid;
-    o++;
-  }
-  setframe_gc(o, obj2gco(fn), fntp);
-  setframe_ftsz(o, ((char *)(o+1) - (char *)L->base) + FRAME_CONT);
-  L->top = L->base = ++o;
-  if (!ct)
-    lj_err_caller(cts->L, LJ_ERR_FFI_BADCBACK);
-  if (isluafunc(fn))
-    setcframe_pc(L->cframe, proto_bc(funcproto(fn))+1);
-  lj_state_checkstack(L, LUA_MINSTACK);  /* May throw. */
-  o = L->base;  /* Might have been reallocated. */
-
 #if LJ_TARGET_X86
   /* x86 has several different calling conventions. */
   switch (ctype_cconv(ct->info)) {
@@ -574,48 +567,159 @@ static void callback_conv_args(CTState *cts, lua_State *L)
   }
 #endif
 
+  sig->id = (CTypeID1)ctype_typeid(cts, ct);
   fid = ct->sib;
   while (fid) {
     CType *ctf = ctype_get(cts, fid);
     if (!ctype_isattrib(ctf->info)) {
+      CCallbackArg *a = &sig->arg[narg++];
       CType *cta;
       void *sp;
       CTSize sz;
+      MSize ofs;
       int isfp;
       MSize n;
       lj_assertCTS(ctype_isfield(ctf->info), "field expected");
+      lj_assertCTS(narg <= LUA_MINSTACK-3, "too many callback arguments");
       cta = ctype_rawchild(cts, ctf);
       isfp = ctype_isfp(cta->info);
       sz = (cta->size + CTSIZE_PTR-1) & ~(CTSIZE_PTR-1);
       n = sz / CTSIZE_PTR;  /* Number of GPRs or stack slots needed. */
+      a->kind = callback_argkind(cta);
+      a->id = (CTypeID1)ctype_typeid(cts, cta);
 
       CALLBACK_HANDLE_REGARG  /* Handle register arguments. */
 
       /* Otherwise pass argument on stack. */
       if (CCALL_ALIGN_STACKARG && LJ_32 && sz == 8)
 	nsp = (nsp + 1) & ~1u;  /* Align 64 bit argument on stack. */
-      sp = &stack[nsp];
+      sp = NULL;
+      ofs = nsp*CTSIZE_PTR;
+      a->kind |= CBARG_STACK;
       nsp += n;
 
     done:
+      if (sp)
+	ofs = (MSize)((char *)sp - (char *)&cts->cb);
       if (LJ_BE && cta->size < CTSIZE_PTR
 #if LJ_TARGET_MIPS64
 	  && !(isfp && nsp)
 #endif
 	 )
-	sp = (void *)((uint8_t *)sp + CTSIZE_PTR-cta->size);
-      gcsteps += lj_cconv_tv_ct(cts, cta, 0, o++, sp);
+	ofs += CTSIZE_PTR-cta->size;
+      lj_assertCTS(ofs <= 255, "callback argument offset out of range");
+      a->ofs = (uint8_t)ofs;
     }
     fid = ctf->sib;
   }
+  sig->narg = (uint8_t)narg;
+  sig->nsp = (uint8_t)nsp;
+}
+
+/* Get the cached signature for a callback function type.
+** Only valid until the next call, since colliding types share an entry.
+*/
+static CCallbackSig *callback_sig(CTState *cts, CTypeID id)
+{
+  CCallbackSig *sig = cts->cb.sig;
+  if (LJ_UNLIKELY(!sig)) {
+    sig = lj_mem_newvec(cts->L, CCALL_CBSIG_CACHE, CCallbackSig);
+    memset(sig, 0, CCALL_CBSIG_CACHE*sizeof(CCallbackSig));
+    cts->cb.sig = sig;
+  }
+  sig += (id & (CCALL_CBSIG_CACHE-1));
+  if (LJ_UNLIKELY(sig->id != id))
+    callback_sig_init(cts, ctype_get(cts, id), sig);
+  return sig;
+}
+
+/* Convert and push callback arguments to Lua stack. */
+static void callback_conv_args(CTState *cts, lua_State *L)
+{
+  TValue *o = L->top;
+  MSize slot = cts->cb.slot;
+  CTypeID id = 0, rid;
+  int gcsteps = 0;
+  CType *ct;
+  CCallbackSig *sig;
+  CCallbackArg *a, *ae;
+  GCfunc *fn;
+  int fntp;
+
+  if (slot < cts->cb.sizeid && (id = cts->cb.cbid[slot]) != 0) {
+    ct = ctype_get(cts, id);
+    rid = ctype_cid(ct->info);  /* Return type. x86: +(spadj<<16). */
+    fn = funcV(lj_tab_getint(cts->miscmap, (int32_t)slot));
+    fntp = LJ_TFUNC;
+  } else {  /* Must set up frame first, before throwing the error. */
+    ct = NULL;
+    rid = 0;
+    fn = (GCfunc *)L;
+    fntp = LJ_TTHREAD;
+  }
+  /* Continuation returns from callback. */
+  if (LJ_FR2) {
+    (o++)->u64 = LJ_CONT_FFI_CALLBACK;
+    (o++)->u64 = rid;
+    o++;
+  } else {
+    o->u32.lo = LJ_CONT_FFI_CALLBACK;
+    o->u32.hi = rid;
+    o++;
+  }
+  setframe_gc(o, obj2gco(fn), fntp);
+  setframe_ftsz(o, ((char *)(o+1) - (char *)L->base) + FRAME_CONT);
+  L->top = L->base = ++o;
+  if (!ct)
+    lj_err_caller(cts->L, LJ_ERR_FFI_BADCBACK);
+  if (isluafunc(fn))
+    setcframe_pc(L->cframe, proto_bc(funcproto(fn))+1);
+  lj_state_checkstack(L, LUA_MINSTACK);  /* May throw. */
+  o = L->base;  /* Might have been reallocated. */
+
+  sig = callback_sig(cts, id);
+  for (a = sig->arg, ae = a + sig->narg; a < ae; a++, o++) {
+    uint8_t *sp = (a->kind & CBARG_STACK) ? (uint8_t *)cts->cb.stack :
+					     (uint8_t *)&cts->cb;
+    sp += a->ofs;
+    switch (a->kind & ~CBARG_STACK) {
+    case CBARG_I8: setintV(o, *(int8_t *)sp); break;
+    case CBARG_U8: setintV(o, *(uint8_t *)sp); break;
+    case CBARG_I16: setintV(o, *(int16_t *)sp); break;
+    case CBARG_U16: setintV(o, *(uint16_t *)sp); break;
+    case CBARG_I32: setintV(o, *(int32_t *)sp); break;
+    case CBARG_U32:
+      if (LJ_DUALNUM && *(int32_t *)sp >= 0)
+	setintV(o, *(int32_t *)sp);
+      else
+	setnumV(o, (lua_Number)*(uint32_t *)sp);
+      break;
+    case CBARG_FLOAT: setnumV(o, (lua_Number)*(float *)sp); break;
+    case CBARG_DOUBLE:
+      /* Numbers are NOT canonicalized here! Beware of uninitialized data. */
+      o->n = *(double *)sp;
+      lj_assertCTS(tvisnum(o), "non-canonical NaN passed");
+      break;
+    case CBARG_BOOL8: case CBARG_BOOL32: {
+      uint32_t b = (a->kind & ~CBARG_STACK) == CBARG_BOOL8 ?
+		   (*sp != 0) : (*(int *)sp != 0);
+      setboolV(o, b);
+      setboolV(&cts->g->tmptv2, b);  /* Remember for trace recorder. */
+      break;
+      }
+    default:
+      gcsteps += lj_cconv_tv_ct(cts, ctype_get(cts, a->id), 0, o, sp);
+      break;
+    }
+  }
   L->top = o;
 #if LJ_TARGET_X86
   /* Store stack adjustment for returns from non-cdecl callbacks. */
   if (ctype_cconv(ct->info) != CTCC_CDECL) {
 #if LJ_FR2
-    (L->base-3)->u64 |= (nsp << (16+2));
+    (L->base-3)->u64 |= ((uint64_t)sig->nsp << (16+2));
 #else
-    (L->base-2)->u32.hi |= (nsp << (16+2));
+    (L->base-2)->u32.hi |= (sig->nsp << (16+2));
 #endif
   }
 #endif
@@ -644,7 +748,17 @@ static void callback_conv_result(CTState *cts, lua_State *L, TValue *o)
     if (ctype_isfp(ctr->info) && ctr->size == sizeof(float))
       dp = (uint8_t *)&cts->cb.fpr[0].f[1];
 #endif
-    lj_cconv_ct_tv(cts, ctr, dp, o, 0);
+    /* Fast paths for the most common result types, e.g. comparators. */
+    if (tvisint(o) && ctype_isinteger(ctr->info) && ctr->size == 4)
+      *(int32_t *)dp = intV(o);
+    else if (tvisnum(o) && ctype_isinteger(ctr->info) && ctr->size == 4 &&
+	     !(ctr->info & CTF_UNSIGNED))
+      *(int32_t *)dp = lj_num2int(numV(o));
+    else if (tvisnum(o) && ctype_isfp(ctr->info) &&
+	     ctr->size == sizeof(double))
+      *(double *)dp = numV(o);
+    else
+      lj_cconv_ct_tv(cts, ctr, dp, o, 0);
 #ifdef CALLBACK_HANDLE_RET
     CALLBACK_HANDLE_RET
 #endif
@@ -781,6 +895,7 @@ void *lj_ccallback_new(CTState *cts, CType *ct, GCfunc *fn)
   if (ct) {
     MSize slot = callback_slot_new(cts, ct);
     GCtab *t = cts->miscmap;
+    callback_sig(cts, cts->cb.cbid[slot]);  /* Precompute conversions. */
     setfuncV(cts->L, lj_tab_setint(cts->L, t, (int32_t)slot), fn);
     lj_gc_anybarriert(cts->L, t);
     return callback_slot2ptr(cts, slot);
@@ -788,4 +903,14 @@ void *lj_ccallback_new(CTState *cts, CType *ct, GCfunc *fn)
   return NULL;  /* Bad conversion. */
 }
 
+/* Purge the signatures of function types removed by a rollback. */
+void lj_ccallback_rollback(CTState *cts, CTypeID top)
+{
+  MSize i;
+  if (cts->cb.sig) {
+    for (i = 0; i < CCALL_CBSIG_CACHE; i++)
+      if (cts->cb.sig[i].id >= top) cts->cb.sig[i].id = 0;
+  }
+}
+
 #endif
@@ -468,8 +468,90 @@ int lj_cconv_tv_bf(CTState *cts, CType *s, TValue *o, uint8_t *sp)
   return 0;  /* No GC step needed. */
 }
 
+/* Convert C number array to consecutive TValues. Returns 0 for NYI.
+** Only handles element types which never need a GC step. The loops are
+** kept free of calls and branches on the element, so they vectorize.
+*/
+int lj_cconv_tv_numarray(CType *s, TValue *o, uint8_t *sp, MSize n)
+{
+  CTInfo sinfo = s->info;
+  CTSize esize = s->size;
+  MSize i;
+  if (!ctype_isnum(sinfo) || ctype_isbool(sinfo))
+    return 0;
+  if (ctype_isfp(sinfo)) {
+    if (esize == sizeof(double)) {
+      for (i = 0; i < n; i++) o[i].n = ((double *)sp)[i];
+    } else if (esize == sizeof(float)) {
+      for (i = 0; i < n; i++) o[i].n = (double)((float *)sp)[i];
+    } else {
+      return 0;  /* NYI: long double. */
+    }
+    /* Canonicalize NaNs, unlike lj_cconv_tv_ct. These end up in a table. */
+    for (i = 0; i < n; i++)
+      if (LJ_UNLIKELY(!tvisnum(&o[i]))) setnanV(&o[i]);
+    return 1;
+  }
+  if (LJ_DUALNUM || esize > 4)
+    return 0;  /* Need integer TValues or 64 bit cdata. */
+  if (esize == 4) {
+    if ((sinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) o[i].n = (double)((uint32_t *)sp)[i];
+    else
+      for (i = 0; i < n; i++) o[i].n = (double)((int32_t *)sp)[i];
+  } else if (esize == 2) {
+    if ((sinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) o[i].n = (double)((uint16_t *)sp)[i];
+    else
+      for (i = 0; i < n; i++) o[i].n = (double)((int16_t *)sp)[i];
+  } else {
+    if ((sinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) o[i].n = (double)sp[i];
+    else
+      for (i = 0; i < n; i++) o[i].n = (double)((int8_t *)sp)[i];
+  }
+  return 1;
+}
+
 /* -- TValue to C type conversion ----------------------------------------- */
 
+/* Convert a run of plain numbers to a C number array. Returns the count.
+** The conversions must exactly match CCX(I, F) and CCX(F, F) above.
+*/
+static MSize cconv_numarray_tv(CType *d, uint8_t *dp, cTValue *o, MSize n)
+{
+  CTInfo dinfo = d->info;
+  CTSize esize = d->size;
+  MSize i;
+  for (i = 0; i < n; i++)
+    if (!tvisnum(&o[i])) break;
+  n = i;
+  if (ctype_isfp(dinfo)) {
+    if (esize == sizeof(double))
+      for (i = 0; i < n; i++) ((double *)dp)[i] = o[i].n;
+    else if (esize == sizeof(float))
+      for (i = 0; i < n; i++) ((float *)dp)[i] = (float)o[i].n;
+    else
+      return 0;  /* NYI: long double. */
+  } else if (esize == 4 && !(dinfo & CTF_UNSIGNED)) {
+    for (i = 0; i < n; i++) ((int32_t *)dp)[i] = (int32_t)o[i].n;
+  } else if (esize == 2) {
+    for (i = 0; i < n; i++) ((int16_t *)dp)[i] = (int16_t)(int32_t)o[i].n;
+  } else if (esize == 1) {
+    for (i = 0; i < n; i++) ((int8_t *)dp)[i] = (int8_t)(int32_t)o[i].n;
+  } else if (esize == 4) {
+    for (i = 0; i < n; i++) ((uint32_t *)dp)[i] = (uint32_t)o[i].n;
+  } else if (esize == 8) {
+    if (!(dinfo & CTF_UNSIGNED))
+      for (i = 0; i < n; i++) ((int64_t *)dp)[i] = (int64_t)o[i].n;
+    else
+      for (i = 0; i < n; i++) ((uint64_t *)dp)[i] = lj_num2u64(o[i].n);
+  } else {
+    return 0;
+  }
+  return n;
+}
+
 /* Convert table to array. */
 static void cconv_array_tab(CTState *cts, CType *d,
 			    uint8_t *dp, GCtab *t, CTInfo flags)
@@ -477,7 +559,18 @@ static void cconv_array_tab(CTState *cts, CType *d,
   int32_t i;
   CType *dc = ctype_rawchild(cts, d);  /* Array element type. */
   CTSize size = d->size, esize = dc->size, ofs = 0;
-  for (i = 0; ; i++) {
+  i = 0;
+  if (ctype_isnum(dc->info) && !ctype_isbool(dc->info) && t->asize > 1) {
+    /* Bulk-convert the leading numbers of the array part. */
+    cTValue *arr = tvref(t->array);
+    MSize n = size / esize;  /* Stop at the initializer limit. */
+    if (tvisnil(arr)) i = 1;  /* 1-based table. */
+    if (n > t->asize - (MSize)i) n = t->asize - (MSize)i;
+    n = cconv_numarray_tv(dc, dp, arr + i, n);
+    i += (int32_t)n;
+    ofs = n * esize;
+  }
+  for (; ; i++) {
     TValue *tv = (TValue *)lj_tab_getint(t, i);
     if (!tv || tvisnil(tv)) {
       if (i == 0) continue;  /* Try again for 1-based tables. */
@@ -60,6 +60,7 @@ LJ_FUNC int lj_cconv_ct_ct(CTState *cts, CType *d, CType *s,
 LJ_FUNC int lj_cconv_tv_ct(CTState *cts, CType *s, CTypeID sid,
 			   TValue *o, uint8_t *sp);
 LJ_FUNC int lj_cconv_tv_bf(CTState *cts, CType *s, TValue *o, uint8_t *sp);
+LJ_FUNC int lj_cconv_tv_numarray(CType *s, TValue *o, uint8_t *sp, MSize n);
 LJ_FUNC void lj_cconv_ct_tv(CTState *cts, CType *d,
 			    uint8_t *dp, TValue *o, CTInfo flags);
 LJ_FUNC void lj_cconv_bf_tv(CTState *cts, CType *d, uint8_t *dp, TValue *o);
@@ -10,6 +10,7 @@
 #include "lj_gc.h"
 #include "lj_err.h"
 #include "lj_tab.h"
+#include "lj_udata.h"
 #include "lj_ctype.h"
 #include "lj_cconv.h"
 #include "lj_cdata.h"
@@ -59,6 +60,20 @@ GCcdata *lj_cdata_newx(CTState *cts, CTypeID id, CTSize sz, CTInfo info)
     return lj_cdata_newv(cts->L, id, sz, ctype_align(info));
 }
 
+/* Create a new FFI arena with size bytes of memory and push it. */
+CArena *lj_cdata_newarena(lua_State *L, MSize size, GCtab *mt)
+{
+  GCudata *ud = lj_udata_new(L, (MSize)sizeof(CArena) + size, mt);
+  CArena *ca = (CArena *)uddata(ud);
+  ud->udtype = UDTYPE_FFI_ARENA;
+  /* NOBARRIER: The GCudata is new (marked white). */
+  setgcref(ud->metatable, obj2gco(mt));
+  setudataV(L, L->top++, ud);
+  ca->top = carena_base(ca);
+  ca->end = carena_base(ca) + size;
+  return ca;
+}
+
 /* Free a C data object. */
 void LJ_FASTCALL lj_cdata_free(global_State *g, GCcdata *cd)
 {
@@ -58,12 +58,22 @@ static LJ_AINLINE GCcdata *lj_cdata_new_(lua_State *L, CTypeID id, CTSize sz)
   return cd;
 }
 
+/* FFI arena. Stored in the payload of a userdata, followed by the memory. */
+typedef struct CArena {
+  char *top;		/* Next free byte. */
+  char *end;		/* End of arena memory. */
+} CArena;
+
+#define carena_base(ca)	((char *)((ca)+1))
+
 LJ_FUNC GCcdata *lj_cdata_newref(CTState *cts, const void *pp, CTypeID id);
 LJ_FUNC GCcdata *lj_cdata_newv(lua_State *L, CTypeID id, CTSize sz,
 			       CTSize align);
 LJ_FUNC GCcdata *lj_cdata_newx(CTState *cts, CTypeID id, CTSize sz,
 			       CTInfo info);
 
+LJ_FUNC CArena *lj_cdata_newarena(lua_State *L, MSize size, GCtab *mt);
+
 LJ_FUNC void LJ_FASTCALL lj_cdata_free(global_State *g, GCcdata *cd);
 LJ_FUNC void lj_cdata_setfin(lua_State *L, GCcdata *cd, GCobj *obj,
 			     uint32_t it);
@@ -148,33 +148,57 @@ typedef struct CRecMemList {
   TRef trval;		/* TRef of load value. */
 } CRecMemList;
 
-/* Generate copy list for element-wise struct copy. */
-static MSize crec_copy_struct(CRecMemList *ml, CTState *cts, CType *ct)
+/* Add a copy list entry. Returns 0 on overflow. */
+static MSize crec_copy_add(CRecMemList *ml, MSize mlp, CTSize ofs, IRType tp)
+{
+  if (mlp >= CREC_COPY_MAXUNROLL) return 0;
+  ml[mlp].ofs = ofs;
+  ml[mlp].tp = tp;
+  return mlp+1;
+}
+
+/* Generate copy list for element-wise struct copy. Returns 0 for NYI. */
+static MSize crec_copy_struct(CRecMemList *ml, MSize mlp, CTState *cts,
+			      CType *ct, CTSize ofs)
 {
   CTypeID fid = ct->sib;
-  MSize mlp = 0;
   while (fid) {
     CType *df = ctype_get(cts, fid);
     fid = df->sib;
     if (ctype_isfield(df->info)) {
       CType *cct;
       IRType tp;
+      CTSize fofs = ofs + df->size;
       if (!gcref(df->name)) continue;  /* Ignore unnamed fields. */
       cct = ctype_rawchild(cts, df);  /* Field type. */
-      tp = crec_ct2irt(cts, cct);
-      if (tp == IRT_CDATA) return 0;  /* NYI: aggregates. */
-      if (mlp >= CREC_COPY_MAXUNROLL) return 0;
-      ml[mlp].ofs = df->size;
-      ml[mlp].tp = tp;
-      mlp++;
-      if (ctype_iscomplex(cct->info)) {
-	if (mlp >= CREC_COPY_MAXUNROLL) return 0;
-	ml[mlp].ofs = df->size + (cct->size >> 1);
-	ml[mlp].tp = tp;
-	mlp++;
+      if (ctype_isstruct(cct->info) && !(cct->info & CTF_UNION)) {
+	mlp = crec_copy_struct(ml, mlp, cts, cct, fofs);  /* Sub-structure. */
+	if (!mlp) return 0;
+	continue;
+      } else if (ctype_isarray(cct->info) && !ctype_iscomplex(cct->info)) {
+	CType *ect = ctype_rawchild(cts, cct);  /* Array element type. */
+	CTSize eofs;
+	tp = crec_ct2irt(cts, ect);
+	if (tp == IRT_CDATA || ctype_iscomplex(ect->info) ||
+	    cct->size == CTSIZE_INVALID)
+	  return 0;  /* NYI: arrays of aggregates and VLS. */
+	for (eofs = 0; eofs < cct->size; eofs += ect->size)
+	  if (!(mlp = crec_copy_add(ml, mlp, fofs + eofs, tp))) return 0;
+	continue;
       }
+      tp = crec_ct2irt(cts, cct);
+      if (tp == IRT_CDATA) return 0;  /* NYI: unions and other aggregates. */
+      if (!(mlp = crec_copy_add(ml, mlp, fofs, tp))) return 0;
+      if (ctype_iscomplex(cct->info) &&
+	  !(mlp = crec_copy_add(ml, mlp, fofs + (cct->size >> 1), tp)))
+	return 0;
+    } else if (ctype_isxattrib(df->info, CTA_SUBTYPE)) {
+      CType *cct = ctype_rawchild(cts, df);  /* Anonymous sub-structure. */
+      if ((cct->info & CTF_UNION)) return 0;
+      mlp = crec_copy_struct(ml, mlp, cts, cct, ofs + df->size);
+      if (!mlp) return 0;
     } else if (!ctype_isconstval(df->info)) {
-      /* NYI: bitfields and sub-structures. */
+      /* NYI: bitfields. */
       return 0;
     }
   }
@@ -253,7 +277,7 @@ static void crec_copy(jit_State *J, TRef trdst, TRef trsrc, TRef trlen,
 	step = (1u << ctype_align(ct->info));
 	goto rawcopy;
       } else {
-	mlp = crec_copy_struct(ml, cts, ct);
+	mlp = crec_copy_struct(ml, 0, cts, ct, 0);
 	goto emitcopy;
       }
     } else {
@@ -600,6 +624,117 @@ static TRef crec_tv_ct(jit_State *J, CType *s, CTypeID sid, TRef sp)
 
 /* -- Convert TValue to C type (store) ------------------------------------ */
 
+/* Record raw table lookup of an aggregate initializer. */
+static TRef crec_tab_get(jit_State *J, TRef trtab, GCtab *t, GCstr *name,
+			 int32_t i, cTValue **tvp)
+{
+  RecordIndex ix;
+  cTValue *tv;
+  ix.tab = trtab;
+  settabV(J->L, &ix.tabv, t);
+  if (name) {
+    setstrV(J->L, &ix.keyv, name);
+    ix.key = lj_ir_kstr(J, name);
+    tv = lj_tab_getstr(t, name);
+  } else {
+    setintV(&ix.keyv, i);
+    ix.key = lj_ir_kint(J, i);
+    tv = lj_tab_getint(t, i);
+  }
+  ix.val = 0; ix.idxchain = 0;
+  *tvp = tv ? tv : niltvg(J2G(J));
+  return lj_record_idx(J, &ix);
+}
+
+/* Record conversion of table to sub-struct/union. */
+static void crec_substruct_tab(jit_State *J, CType *d, TRef dp,
+			       TRef trtab, GCtab *t, int32_t *ip)
+{
+  CTState *cts = ctype_ctsG(J2G(J));
+  CTypeID id = d->sib;
+  while (id) {
+    CType *df = ctype_get(cts, id);
+    id = df->sib;
+    if (ctype_isfield(df->info) || ctype_isbitfield(df->info)) {
+      cTValue *tv;
+      TRef tr;
+      int32_t i = *ip, iz = i;
+      if (!gcref(df->name)) continue;  /* Ignore unnamed fields. */
+      if (i >= 0) {
+      retry:
+	tr = crec_tab_get(J, trtab, t, NULL, i, &tv);
+	if (tref_isnil(tr)) {
+	  if (i == 0) { i = 1; goto retry; }  /* 1-based tables. */
+	  if (iz == 0) { *ip = i = -1; goto tryname; }  /* Init named fields. */
+	  break;  /* Stop at first nil. */
+	}
+	*ip = i + 1;
+      } else {
+      tryname:
+	tr = crec_tab_get(J, trtab, t, gco2str(gcref(df->name)), 0, &tv);
+	if (tref_isnil(tr)) continue;
+      }
+      if (!ctype_isfield(df->info))
+	lj_trace_err(J, LJ_TRERR_NYICONV);  /* NYI: init bitfields. */
+      lj_crec_ct_tv(J, ctype_rawchild(cts, df),
+		    emitir(IRT(IR_ADD, IRT_PTR), dp, lj_ir_kintp(J, df->size)),
+		    tr, tv);
+      if ((d->info & CTF_UNION)) break;
+    } else if (ctype_isxattrib(df->info, CTA_SUBTYPE)) {
+      TRef sdp = emitir(IRT(IR_ADD, IRT_PTR), dp, lj_ir_kintp(J, df->size));
+      crec_substruct_tab(J, ctype_rawchild(cts, df), sdp, trtab, t, ip);
+    }  /* Ignore all other entries in the chain. */
+  }
+}
+
+/* Record conversion of table to array or struct/union. */
+static void crec_ct_tab(jit_State *J, CType *d, TRef dp, TRef trtab,
+			GCtab *t)
+{
+  CTState *cts = ctype_ctsG(J2G(J));
+  CTSize size = d->size;
+  if (size == CTSIZE_INVALID || size > CREC_COPY_MAXLEN)
+    lj_trace_err(J, LJ_TRERR_NYICONV);  /* NYI: init large/VLA/VLS types. */
+  if (ctype_isarray(d->info)) {
+    CType *dc = ctype_rawchild(cts, d);  /* Array element type. */
+    CTSize esize = dc->size, ofs = 0;
+    TRef tr0 = 0;
+    cTValue *tv0 = NULL;
+    int32_t i;
+    for (i = 0; ; i++) {
+      cTValue *tv;
+      TRef tr = crec_tab_get(J, trtab, t, NULL, i, &tv);
+      if (tref_isnil(tr)) {
+	if (i == 0) continue;  /* Try again for 1-based tables. */
+	break;  /* Stop at first nil. */
+      }
+      if (ofs >= size)
+	lj_trace_err(J, LJ_TRERR_NYICONV);  /* Interpreter throws. */
+      lj_crec_ct_tv(J, dc,
+		    emitir(IRT(IR_ADD, IRT_PTR), dp, lj_ir_kintp(J, ofs)),
+		    tr, tv);
+      if (ofs == 0) { tr0 = tr; tv0 = tv; }
+      ofs += esize;
+    }
+    if (ofs == esize) {  /* Replicate a single element. */
+      for (; ofs < size; ofs += esize)
+	lj_crec_ct_tv(J, dc,
+		      emitir(IRT(IR_ADD, IRT_PTR), dp, lj_ir_kintp(J, ofs)),
+		      tr0, tv0);
+    } else if (ofs < size) {  /* Otherwise fill the remainder with zero. */
+      crec_fill(J, emitir(IRT(IR_ADD, IRT_PTR), dp, lj_ir_kintp(J, ofs)),
+		lj_ir_kint(J, (int32_t)(size - ofs)), lj_ir_kint(J, 0),
+		(1u << ctype_align(dc->info)));
+    }
+  } else {
+    int32_t i = 0;
+    /* Much simpler to clear the struct first. */
+    crec_fill(J, dp, lj_ir_kint(J, (int32_t)size), lj_ir_kint(J, 0),
+	      (1u << ctype_align(d->info)));
+    crec_substruct_tab(J, d, dp, trtab, t, &i);
+  }
+}
+
 TRef lj_crec_ct_tv(jit_State *J, CType *d, TRef dp, TRef sp, cTValue *sval)
 {
   CTState *cts = ctype_ctsG(J2G(J));
@@ -652,7 +787,12 @@ TRef lj_crec_ct_tv(jit_State *J, CType *d, TRef dp, TRef sp, cTValue *sval)
     sp = emitir(IRT(IR_BAND, IRT_P64), sp,
 		lj_ir_kint64(J, U64x(00007fff,ffffffff)));
 #endif
-  } else {  /* NYI: tref_istab(sp). */
+  } else if (tref_istab(sp)) {
+    if (!dp || !(ctype_isarray(d->info) || ctype_isstruct(d->info)))
+      lj_trace_err(J, LJ_TRERR_NYICONV);
+    crec_ct_tab(J, d, dp, sp, tabV(sval));
+    return 0;
+  } else {
     IRType t;
     sid = argv2cdata(J, sp, sval)->ctypeid;
     s = ctype_raw(cts, sid);
@@ -749,10 +889,40 @@ static void crec_index_meta(jit_State *J, CTState *cts, CType *ct,
       lj_trace_err(J, LJ_TRERR_BADTYPE);
     /* Always specialize to the key. */
     emitir(IRTG(IR_EQ, IRT_STR), J->base[1], lj_ir_kstr(J, strV(&rd->argv[1])));
+  } else if (tvistab(tv) && !gcref(tabV(tv)->metatable)) {
+    GCtab *t = tabV(tv);
+    if (rd->data == 0 && tref_isk(J->base[1])) {
+      /* The __index table is immutable. Constify lookup for constant key. */
+      J->base[0] = lj_record_constify(J, lj_tab_get(J->L, t, &rd->argv[1]));
+      if (!J->base[0])
+	lj_trace_err(J, LJ_TRERR_BADTYPE);
+    } else {
+      /* Record lookup in or store to the constant table. */
+      RecordIndex ix;
+      ix.tab = lj_ir_kgc(J, obj2gco(t), IRT_TAB);
+      settabV(J->L, &ix.tabv, t);
+      ix.key = J->base[1];
+      copyTV(J->L, &ix.keyv, &rd->argv[1]);
+      ix.idxchain = 1;  /* Only to guard against a later metatable. */
+      if (rd->data == 0) {
+	/* The interpreter throws for nil. Let the type guard catch it. */
+	if (tvisnil(lj_tab_get(J->L, t, &rd->argv[1])))
+	  lj_trace_err(J, LJ_TRERR_BADTYPE);
+	ix.val = 0;
+	J->base[0] = lj_record_idx(J, &ix);
+      } else {
+	/* Record store to the __newindex table,
+	** not folded since it may change.
+	*/
+	ix.val = J->base[2];
+	copyTV(J->L, &ix.valv, &rd->argv[2]);
+	lj_record_idx(J, &ix);
+	rd->nres = 0;
+	J->needsnap = 1;
+      }
+    }
   } else {
-    /* NYI: resolving of non-function metamethods. */
-    /* NYI: non-string keys for __index table. */
-    /* NYI: stores to __newindex table. */
+    /* NYI: resolving of other non-function metamethods. */
     lj_trace_err(J, LJ_TRERR_BADTYPE);
   }
 }
@@ -1012,6 +1182,25 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
       TValue *sval = &tv;
       MSize i;
       tv.u64 = 0;
+      if (ctype_isstruct(dc->info) || ctype_isarray(dc->info)) {
+	/* Initialize sub-aggregates from tables or cdata, or clear them. */
+	TRef dp0 = 0;
+	for (i = 1, ofs = 0; ofs < sz; ofs += esize) {
+	  TRef dp = emitir(IRT(IR_ADD, IRT_PTR), trcd,
+			   lj_ir_kintp(J, ofs + sizeof(GCcdata)));
+	  if (J->base[i]) {
+	    lj_crec_ct_tv(J, dc, dp, J->base[i], &rd->argv[i]);
+	    i++;
+	  } else if (i != 2) {
+	    crec_fill(J, dp, lj_ir_kint(J, (int32_t)esize), lj_ir_kint(J, 0),
+		      (1u << ctype_align(dc->info)));
+	  } else {  /* Replicate a single element. */
+	    crec_copy(J, dp, dp0, lj_ir_kint(J, (int32_t)esize), dc);
+	  }
+	  if (!dp0) dp0 = dp;
+	}
+	goto done;
+      }
       if (!(ctype_isnum(dc->info) || ctype_isptr(dc->info)) ||
 	  esize * CREC_FILL_MAXUNROLL < sz)
 	goto special;
@@ -1030,6 +1219,12 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
     } else if (ctype_isstruct(d->info)) {
       CTypeID fid = d->sib;
       MSize i = 1;
+      if ((d->info & CTF_UNION)) {  /* Clear the union, init first field. */
+	crec_fill(J, emitir(IRT(IR_ADD, IRT_PTR), trcd,
+			    lj_ir_kintp(J, sizeof(GCcdata))),
+		  lj_ir_kint(J, (int32_t)sz), lj_ir_kint(J, 0),
+		  (1u << ctype_align(info)));
+      }
       while (fid) {
 	CType *df = ctype_get(cts, fid);
 	fid = df->sib;
@@ -1041,21 +1236,35 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
 	  setintV(&tv, 0);
 	  if (!gcref(df->name)) continue;  /* Ignore unnamed fields. */
 	  dc = ctype_rawchild(cts, df);  /* Field type. */
-	  if (!(ctype_isnum(dc->info) || ctype_isptr(dc->info) ||
-		ctype_isenum(dc->info)))
-	    lj_trace_err(J, LJ_TRERR_NYICONV);  /* NYI: init aggregates. */
-	  if (J->base[i]) {
-	    sp = J->base[i];
-	    sval = &rd->argv[i];
-	    i++;
-	  } else {
-	    sp = ctype_isptr(dc->info) ? TREF_NIL : lj_ir_kint(J, 0);
-	  }
 	  dp = emitir(IRT(IR_ADD, IRT_PTR), trcd,
 		      lj_ir_kintp(J, df->size + sizeof(GCcdata)));
-	  lj_crec_ct_tv(J, dc, dp, sp, sval);
+	  if (ctype_isstruct(dc->info) || ctype_isarray(dc->info)) {
+	    /* Initialize sub-aggregate from a table or cdata, or clear it. */
+	    if (J->base[i]) {
+	      lj_crec_ct_tv(J, dc, dp, J->base[i], &rd->argv[i]);
+	      i++;
+	    } else if (!(d->info & CTF_UNION)) {
+	      crec_fill(J, dp, lj_ir_kint(J, (int32_t)dc->size),
+			lj_ir_kint(J, 0), (1u << ctype_align(dc->info)));
+	    }
+	  } else {
+	    if (!(ctype_isnum(dc->info) || ctype_isptr(dc->info) ||
+		  ctype_isenum(dc->info)))
+	      lj_trace_err(J, LJ_TRERR_NYICONV);  /* NYI: init vectors. */
+	    if (J->base[i]) {
+	      sp = J->base[i];
+	      sval = &rd->argv[i];
+	      i++;
+	    } else if ((d->info & CTF_UNION)) {
+	      break;  /* Already cleared. */
+	    } else {
+	      sp = ctype_isptr(dc->info) ? TREF_NIL : lj_ir_kint(J, 0);
+	    }
+	    lj_crec_ct_tv(J, dc, dp, sp, sval);
+	  }
+	  if ((d->info & CTF_UNION)) break;
 	} else if (!ctype_isconstval(df->info)) {
-	  /* NYI: init bitfields and sub-structures. */
+	  /* NYI: init bitfields and anonymous sub-structures. */
 	  lj_trace_err(J, LJ_TRERR_NYICONV);
 	}
       }
@@ -1072,6 +1281,7 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
       }
     }
   }
+done:
   J->base[0] = trcd;
   /* Handle __gc metamethod. */
   fin = lj_ctype_meta(cts, id, MM_gc);
@@ -1079,15 +1289,130 @@ static void crec_alloc(jit_State *J, RecordFFData *rd, CTypeID id)
     crec_finalizer(J, trcd, 0, fin);
 }
 
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+/* Get IR type of an eightbyte of a small struct. Returns IRT_NIL for NYI. */
+static IRType crec_struct_irt(int rcl, CTSize sz)
+{
+  if (sz > 8) sz = 8;
+  if ((rcl & CCALL_RCL_INT))
+    return sz == 8 ? IRT_I64 : sz == 4 ? IRT_U32 :
+	   sz == 2 ? IRT_U16 : sz == 1 ? IRT_U8 : IRT_NIL;
+  else
+    return sz == 8 ? IRT_NUM : sz == 4 ? IRT_FLOAT : IRT_NIL;
+}
+
+/* Classify a small struct passed or returned in registers. */
+static MSize crec_struct_classify(jit_State *J, CTState *cts, CType *d,
+				  int *rcl)
+{
+  MSize i, ne;
+  if (lj_ccall_classify_struct(cts, d, rcl) || (!rcl[0] && rcl[1]) ||
+      ctype_align(d->info) > CT_MEMALIGN)
+    lj_trace_err(J, LJ_TRERR_NYICALL);  /* NYI: structs in memory. */
+  ne = rcl[1] ? 2 : rcl[0] ? 1 : 0;
+  for (i = 0; i < ne; i++)
+    if (crec_struct_irt(rcl[i], d->size - 8*i) == IRT_NIL)
+      lj_trace_err(J, LJ_TRERR_NYICALL);  /* NYI: odd-sized eightbyte. */
+  return ne;
+}
+
+/* Get pointer to the data of a struct argument. */
+static TRef crec_struct_ptr(jit_State *J, CTState *cts, CType *d,
+			    TRef tr, cTValue *o)
+{
+  if (tref_iscdata(tr)) {
+    CType *s = ctype_raw(cts, argv2cdata(J, tr, o)->ctypeid);
+    if (ctype_isref(s->info)) {
+      tr = emitir(IRT(IR_FLOAD, IRT_PTR), tr, IRFL_CDATA_PTR);
+      s = ctype_rawchild(cts, s);
+    } else {
+      tr = emitir(IRT(IR_ADD, IRT_PTR), tr, lj_ir_kintp(J, sizeof(GCcdata)));
+    }
+    if (s != d)
+      lj_trace_err(J, LJ_TRERR_NYICALL);  /* Interpreter throws. */
+    return tr;
+  } else if (tref_istab(tr)) {  /* Convert table to a temporary struct. */
+    TRef trcd = emitir(IRTG(IR_CNEW, IRT_CDATA),
+		       lj_ir_kint(J, ctype_typeid(cts, d)), TREF_NIL);
+    TRef dp = emitir(IRT(IR_ADD, IRT_PTR), trcd,
+		     lj_ir_kintp(J, sizeof(GCcdata)));
+    crec_ct_tab(J, d, dp, tr, tabV(o));
+    return dp;
+  }
+  lj_trace_err(J, LJ_TRERR_NYICALL);
+  return 0;
+}
+
+/* Pass a small struct argument as one or two eightbytes. */
+static MSize crec_call_structarg(jit_State *J, CTState *cts, CType *d,
+				 TRef tr, cTValue *o, TRef *args, MSize n,
+				 MSize *ngpr, MSize *nfpr)
+{
+  int rcl[2];
+  MSize i, ne = crec_struct_classify(J, cts, d, rcl), ng = 0, nf = 0;
+  TRef sp;
+  if (n + ne > CCI_NARGS_MAX)
+    lj_trace_err(J, LJ_TRERR_NYICALL);
+  for (i = 0; i < ne; i++) {
+    if ((rcl[i] & CCALL_RCL_INT)) ng++; else nf++;
+  }
+  if (*ngpr + ng <= CCALL_NARG_GPR && *nfpr + nf <= CCALL_NARG_FPR) {
+    *ngpr += ng;
+    *nfpr += nf;
+  } else if ((ng && *ngpr < CCALL_NARG_GPR) || (nf && *nfpr < CCALL_NARG_FPR)) {
+    /* NYI: the whole struct goes on the stack, but not all eightbytes. */
+    lj_trace_err(J, LJ_TRERR_NYICALL);
+  }
+  sp = crec_struct_ptr(J, cts, d, tr, o);
+  for (i = 0; i < ne; i++) {
+    IRType t = crec_struct_irt(rcl[i], d->size - 8*i);
+    TRef ptr = i ? emitir(IRT(IR_ADD, IRT_PTR), sp, lj_ir_kintp(J, 8)) : sp;
+    tr = emitir(IRT(IR_XLOAD, t), ptr, 0);
+    if (t == IRT_U8 || t == IRT_U16)
+      tr = emitconv(tr, IRT_INT, t, 0);
+    args[n++] = tr;
+  }
+  return n;
+}
+
+/* Store a small struct returned in one or two registers. */
+static TRef crec_call_structret(jit_State *J, CType *ctr, TRef trid,
+				TRef tr, int *rcl, MSize ne)
+{
+  TRef trv[2], trcd;
+  MSize i;
+  trv[0] = tr;
+  if (ne == 2) {  /* Second eightbyte is in RDX, XMM1 or the other class. */
+    IRType t = crec_struct_irt(rcl[1], ctr->size - 8);
+    if ((rcl[1] & CCALL_RCL_INT)) t = IRT_I64;
+    trv[1] = emitir(IRT(IR_HIOP, t), tr, tr);
+  }
+  trcd = emitir(IRTG(IR_CNEW, IRT_CDATA), trid, TREF_NIL);
+  for (i = 0; i < ne; i++) {
+    IRType t = crec_struct_irt(rcl[i], ctr->size - 8*i);
+    TRef ptr = emitir(IRT(IR_ADD, IRT_PTR), trcd,
+		      lj_ir_kintp(J, sizeof(GCcdata) + 8*i));
+    TRef val = trv[i];
+    if ((rcl[i] & CCALL_RCL_INT) && t != IRT_I64)
+      val = emitconv(val, IRT_INT, IRT_I64, 0);  /* Store partial eightbyte. */
+    emitir(IRT(IR_XSTORE, t), ptr, val);
+  }
+  return trcd;
+}
+#endif
+
 /* Record argument conversions. */
 static TRef crec_call_args(jit_State *J, RecordFFData *rd,
-			   CTState *cts, CType *ct)
+			   CTState *cts, CType *ct, TRef sret)
 {
   TRef args[CCI_NARGS_MAX];
   CTypeID fid;
   MSize i, n;
   TRef tr, *base;
   cTValue *o;
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+  MSize ngpr = sret ? 1 : 0, nfpr = 0;
+#endif
 #if LJ_TARGET_X86
 #if LJ_ABI_WIN
   TRef *arg0 = NULL, *arg1 = NULL;
@@ -1106,8 +1431,9 @@ static TRef crec_call_args(jit_State *J, RecordFFData *rd,
     if (!ctype_isattrib(ctf->info)) break;
     fid = ctf->sib;
   }
-  args[0] = TREF_NIL;
-  for (n = 0, base = J->base+1, o = rd->argv+1; *base; n++, base++, o++) {
+  args[0] = sret ? sret : TREF_NIL;  /* Pointer for struct return. */
+  n = sret ? 1 : 0;
+  for (base = J->base+1, o = rd->argv+1; *base; n++, base++, o++) {
     CTypeID did;
     CType *d;
 
@@ -1125,6 +1451,13 @@ static TRef crec_call_args(jit_State *J, RecordFFData *rd,
       did = lj_ccall_ctid_vararg(cts, o);  /* Infer vararg type. */
     }
     d = ctype_raw(cts, did);
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+    if (ctype_isstruct(d->info)) {  /* Pass struct by value. */
+      n = crec_call_structarg(J, cts, d, *base, o, args, n, &ngpr, &nfpr) - 1;
+      continue;
+    }
+    if (ctype_isfp(d->info)) nfpr++; else ngpr++;
+#endif
     if (!(ctype_isnum(d->info) || ctype_isptr(d->info) ||
 	  ctype_isenum(d->info)))
       lj_trace_err(J, LJ_TRERR_NYICALL);
@@ -1212,8 +1545,13 @@ static int crec_call(jit_State *J, RecordFFData *rd, GCcdata *cd)
     TRef func = emitir(IRT(IR_FLOAD, tp), J->base[0], IRFL_CDATA_PTR);
     CType *ctr = ctype_rawchild(cts, ct);
     IRType t = crec_ct2irt(cts, ctr);
-    TRef tr;
+    TRef tr, sret = 0;
     TValue tv;
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+    TRef trid = 0, trcd = 0;
+    int rcl[2];
+    MSize ne = 0;
+#endif
     /* Check for blacklisted C functions that might call a callback. */
     setlightudV(&tv,
 		cdata_getptr(cdataptr(cd), (LJ_64 && tp == IRT_P64) ? 8 : 4));
@@ -1222,6 +1560,23 @@ static int crec_call(jit_State *J, RecordFFData *rd, GCcdata *cd)
     if (ctype_isvoid(ctr->info)) {
       t = IRT_NIL;
       rd->nres = 0;
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+    } else if (ctype_isstruct(ctr->info)) {  /* Return struct by value. */
+      trid = lj_ir_kint(J, ctype_cid(ct->info));
+      if (lj_ccall_classify_struct(cts, ctr, rcl)) {
+	/* Pass pointer to the result as a hidden first argument. */
+	if (ctype_align(ctr->info) > CT_MEMALIGN)
+	  lj_trace_err(J, LJ_TRERR_NYICALL);
+	trcd = emitir(IRTG(IR_CNEW, IRT_CDATA), trid, TREF_NIL);
+	sret = emitir(IRT(IR_ADD, IRT_PTR), trcd,
+		      lj_ir_kintp(J, sizeof(GCcdata)));
+	t = IRT_NIL;
+      } else {
+	ne = crec_struct_classify(J, cts, ctr, rcl);
+	t = ne == 0 ? IRT_NIL : (rcl[0] & CCALL_RCL_INT) ? IRT_I64 :
+	    crec_struct_irt(rcl[0], ctr->size);
+      }
+#endif
     } else if (!(ctype_isnum(ctr->info) || ctype_isptr(ctr->info) ||
 		 ctype_isenum(ctr->info)) || t == IRT_CDATA) {
       lj_trace_err(J, LJ_TRERR_NYICALL);
@@ -1233,7 +1588,15 @@ static int crec_call(jit_State *J, RecordFFData *rd, GCcdata *cd)
 	)
       func = emitir(IRT(IR_CARG, IRT_NIL), func,
 		    lj_ir_kint(J, ctype_typeid(cts, ct)));
-    tr = emitir(IRT(IR_CALLXS, t), crec_call_args(J, rd, cts, ct), func);
+    tr = emitir(IRT(IR_CALLXS, t), crec_call_args(J, rd, cts, ct, sret), func);
+#if LJ_TARGET_X64 && !LJ_ABI_WIN
+    if (ctype_isstruct(ctr->info)) {
+      J->base[0] = sret ? trcd :
+		   crec_call_structret(J, ctr, trid, tr, rcl, ne);
+      J->needsnap = 1;
+      return 1;
+    }
+#endif
     if (ctype_isbool(ctr->info)) {
       if (frame_islua(J->L->base-1) && bc_b(frame_pc(J->L->base-1)[-1]) == 1) {
 	/* Don't check result if ignored. */
@@ -1653,6 +2016,79 @@ void LJ_FASTCALL recff_ffi_strbuf(jit_State *J, RecordFFData *rd)
   }
 }
 
+/* Get pointer to the CArena of an arena object. Returns 0 if not an arena. */
+static TRef crec_arena(jit_State *J, RecordFFData *rd)
+{
+  TRef tr, trud = J->base[0];
+  if (!(tref_isudata(trud) &&
+	udataV(&rd->argv[0])->udtype == UDTYPE_FFI_ARENA))
+    return 0;  /* Interpreter will throw. */
+  tr = emitir(IRT(IR_FLOAD, IRT_U8), trud, IRFL_UDATA_UDTYPE);
+  emitir(IRTGI(IR_EQ), tr, lj_ir_kint(J, UDTYPE_FFI_ARENA));
+  return emitir(IRT(IR_ADD, IRT_PTR), trud, lj_ir_kintp(J, sizeof(GCudata)));
+}
+
+/* Record arena allocation as an inline bump of the arena pointer. */
+void LJ_FASTCALL recff_ffi_arena_new(jit_State *J, RecordFFData *rd)
+{
+  CTState *cts = ctype_ctsG(J2G(J));
+  TRef trca = crec_arena(J, rd);
+  if (trca && J->base[1]) {
+    CTypeID id = argv2ctype(J, J->base[1], &rd->argv[1]);
+    CType *d = ctype_raw(cts, id);
+    CTSize sz;
+    CTInfo info = lj_ctype_info(cts, id, &sz);
+    TRef trsz, trlen, trtop, trend, tr;
+    ptrdiff_t i = 2;
+    if ((info & CTF_VLA)) {  /* Calculate VLA/VLS size at runtime. */
+      CTSize sz0, sz1;
+      if (!J->base[2]) return;  /* Interpreter will throw. */
+      trlen = crec_toint(J, cts, J->base[2], &rd->argv[2]);
+      emitir(IRTGI(IR_GE), trlen, lj_ir_kint(J, 0));
+      sz0 = lj_ctype_vlsize(cts, d, 0);
+      sz1 = lj_ctype_vlsize(cts, d, 1);
+      trlen = emitir(IRTGI(IR_MULOV), trlen, lj_ir_kint(J, (int32_t)(sz1-sz0)));
+      trlen = emitir(IRTGI(IR_ADDOV), trlen,
+		     lj_ir_kint(J, (int32_t)(sz0 + (1u<<CT_MEMALIGN)-1)));
+      trlen = emitir(IRTI(IR_BAND), trlen,
+		     lj_ir_kint(J, -(int32_t)(1u<<CT_MEMALIGN)));
+      trsz = emitconv(trlen, IRT_INTP, IRT_INT, 0);
+      i = 3;
+    } else {
+      if (sz == CTSIZE_INVALID || sz > LJ_MAX_MEM32)
+	lj_trace_err(J, LJ_TRERR_NYICONV);  /* Interpreter will throw. */
+      sz = (sz + (1u<<CT_MEMALIGN)-1) & ~((1u<<CT_MEMALIGN)-1);
+      trlen = lj_ir_kint(J, (int32_t)sz);
+      trsz = lj_ir_kintp(J, sz);
+    }
+    /* NYI: initializers and over-aligned types. */
+    if (J->base[i] || ctype_align(info) > CT_MEMALIGN)
+      lj_trace_err(J, LJ_TRERR_NYICONV);
+    trtop = emitir(IRT(IR_XLOAD, IRT_PTR), trca, 0);
+    trend = emitir(IRT(IR_ADD, IRT_PTR), trca,
+		   lj_ir_kintp(J, offsetof(CArena, end)));
+    trend = emitir(IRT(IR_XLOAD, IRT_PTR), trend, 0);
+    tr = emitir(IRT(IR_ADD, IRT_PTR), trtop, trsz);
+    emitir(IRTG(IR_ULE, IRT_PTR), tr, trend);
+    emitir(IRT(IR_XSTORE, IRT_PTR), trca, tr);
+    crec_fill(J, trtop, trlen, lj_ir_kint(J, 0), 1u<<CT_MEMALIGN);
+    if (ctype_isrefarray(d->info)) id = ctype_cid(d->info);
+    id = lj_ctype_intern(cts, CTINFO(CT_PTR, CTALIGN_PTR|id), CTSIZE_PTR);
+    J->base[0] = emitir(IRTG(IR_CNEWI, IRT_CDATA), lj_ir_kint(J, id), trtop);
+  }
+}
+
+void LJ_FASTCALL recff_ffi_arena_reset(jit_State *J, RecordFFData *rd)
+{
+  TRef trca = crec_arena(J, rd);
+  if (trca) {
+    TRef tr = emitir(IRT(IR_ADD, IRT_PTR), trca,
+		     lj_ir_kintp(J, sizeof(CArena)));
+    emitir(IRT(IR_XSTORE, IRT_PTR), trca, tr);
+    rd->nres = 0;
+  }
+}
+
 void LJ_FASTCALL recff_ffi_copy(jit_State *J, RecordFFData *rd)
 {
   CTState *cts = ctype_ctsG(J2G(J));
@@ -15,6 +15,7 @@
 #include "lj_ctype.h"
 #include "lj_ccallback.h"
 #include "lj_buf.h"
+#include "lj_vm.h"
 
 /* -- C type definitions -------------------------------------------------- */
 
@@ -142,11 +143,47 @@ CTKWDEF(CTKWNAMEDEF)
 #define CTTYPETAB_MIN		128
 #endif
 
+/* The hash anchors must not be resized in lj_ctype_init(). */
+LJ_STATIC_ASSERT(CTTYPEINFO_NUM < CTHASH_MIN);
+
 /* -- C type interning ---------------------------------------------------- */
 
-#define ct_hashtype(info, size)	(hashrot(info, size) & CTHASH_MASK)
-#define ct_hashname(name) \
-  (hashrot(u32ptr(name), u32ptr(name) + HASH_BIAS) & CTHASH_MASK)
+#define ct_hashtype(info, size)	hashrot(info, size)
+#define ct_hashname(name)	hashrot(u32ptr(name), u32ptr(name) + HASH_BIAS)
+
+/* Double the number of hash anchors and split all hash chains. */
+static void ctype_hashresize(CTState *cts)
+{
+  MSize osize = cts->hmask+1, i;
+  CTypeID1 *hash = lj_mem_newvec(cts->L, 2*osize, CTypeID1);
+  for (i = 0; i < osize; i++) {
+    /* Elements of bucket i move to bucket i or i+osize. Keep chain order. */
+    CTypeID1 *lo = &hash[i], *hi = &hash[i+osize];
+    CTypeID id = cts->hash[i];
+    while (id) {
+      CType *ct = ctype_get(cts, id);
+      GCobj *name = gcref(ct->name);
+      uint32_t h = name ? ct_hashname(name) : ct_hashtype(ct->info, ct->size);
+      if ((h & osize)) { *hi = (CTypeID1)id; hi = &ct->next; }
+      else { *lo = (CTypeID1)id; lo = &ct->next; }
+      id = ct->next;
+    }
+    *lo = *hi = 0;
+  }
+  lj_mem_freevec(cts->g, cts->hash, osize, CTypeID1);
+  cts->hash = hash;
+  cts->hmask = 2*osize-1;
+}
+
+/* Add element to hash chain. Maintains a load factor of at most 1. */
+static LJ_AINLINE void ctype_hashadd(CTState *cts, CType *ct, CTypeID id,
+				     uint32_t h)
+{
+  ct->next = cts->hash[h & cts->hmask];
+  cts->hash[h & cts->hmask] = (CTypeID1)id;
+  if (LJ_UNLIKELY(++cts->hcount > cts->hmask) && cts->hmask < CTID_MAX-1)
+    ctype_hashresize(cts);
+}
 
 /* Create new type element. */
 CTypeID lj_ctype_new(CTState *cts, CType **ctp)
@@ -155,7 +192,7 @@ CTypeID lj_ctype_new(CTState *cts, CType **ctp)
   CType *ct;
   lj_assertCTS(cts->L, "uninitialized cts->L");
   if (LJ_UNLIKELY(id >= cts->sizetab)) {
-    if (id >= CTID_MAX) lj_err_msg(cts->L, LJ_ERR_TABOV);
+    if (id >= CTID_MAX) lj_err_msg(cts->L, LJ_ERR_FFI_TYPEOV);
 #ifdef LUAJIT_CTYPE_CHECK_ANCHOR
     ct = lj_mem_newvec(cts->L, id+1, CType);
     memcpy(ct, cts->tab, id*sizeof(CType));
@@ -181,7 +218,7 @@ CTypeID lj_ctype_new(CTState *cts, CType **ctp)
 CTypeID lj_ctype_intern(CTState *cts, CTInfo info, CTSize size)
 {
   uint32_t h = ct_hashtype(info, size);
-  CTypeID id = cts->hash[h];
+  CTypeID id = cts->hash[h & cts->hmask];
   lj_assertCTS(cts->L, "uninitialized cts->L");
   while (id) {
     CType *ct = ctype_get(cts, id);
@@ -191,39 +228,55 @@ CTypeID lj_ctype_intern(CTState *cts, CTInfo info, CTSize size)
   }
   id = cts->top;
   if (LJ_UNLIKELY(id >= cts->sizetab)) {
-    if (id >= CTID_MAX) lj_err_msg(cts->L, LJ_ERR_TABOV);
+    if (id >= CTID_MAX) lj_err_msg(cts->L, LJ_ERR_FFI_TYPEOV);
     lj_mem_growvec(cts->L, cts->tab, cts->sizetab, CTID_MAX, CType);
   }
   cts->top = id+1;
   cts->tab[id].info = info;
   cts->tab[id].size = size;
   cts->tab[id].sib = 0;
-  cts->tab[id].next = cts->hash[h];
   setgcrefnull(cts->tab[id].name);
-  cts->hash[h] = (CTypeID1)id;
+  ctype_hashadd(cts, &cts->tab[id], id, h);
   return id;
 }
 
 /* Add type element to hash table. */
 static void ctype_addtype(CTState *cts, CType *ct, CTypeID id)
 {
-  uint32_t h = ct_hashtype(ct->info, ct->size);
-  ct->next = cts->hash[h];
-  cts->hash[h] = (CTypeID1)id;
+  ctype_hashadd(cts, ct, id, ct_hashtype(ct->info, ct->size));
 }
 
 /* Add named element to hash table. */
 void lj_ctype_addname(CTState *cts, CType *ct, CTypeID id)
 {
-  uint32_t h = ct_hashname(gcref(ct->name));
-  ct->next = cts->hash[h];
-  cts->hash[h] = (CTypeID1)id;
+  ctype_hashadd(cts, ct, id, ct_hashname(gcref(ct->name)));
+}
+
+/* Remove all type elements created after top. */
+void lj_ctype_rollback(CTState *cts, CTypeID top)
+{
+  MSize i;
+  if (cts->top == top) return;
+  if (cts->sig) {  /* Purge signatures of removed function types. */
+    for (i = 0; i < CCALL_SIG_CACHE; i++)
+      if (cts->sig[i].id >= top) cts->sig[i].id = 0;
+  }
+  lj_ccallback_rollback(cts, top);
+  for (i = 0; i <= cts->hmask; i++) {
+    CTypeID1 *ref = &cts->hash[i];
+    while (*ref) {
+      CType *ct = ctype_get(cts, *ref);
+      if (*ref >= top) { *ref = ct->next; cts->hcount--; }
+      else ref = &ct->next;
+    }
+  }
+  cts->top = top;
 }
 
 /* Get a C type by name, matching the type mask. */
 CTypeID lj_ctype_getname(CTState *cts, CType **ctp, GCstr *name, uint32_t tmask)
 {
-  CTypeID id = cts->hash[ct_hashname(name)];
+  CTypeID id = cts->hash[ct_hashname(name) & cts->hmask];
   while (id) {
     CType *ct = ctype_get(cts, id);
     if (gcref(ct->name) == obj2gco(name) &&
@@ -587,6 +640,226 @@ GCstr *lj_ctype_repr_complex(lua_State *L, void *sp, CTSize size)
   return lj_buf_str(L, sb);
 }
 
+/* -- C type table serialization ------------------------------------------ */
+
+/*
+** A cdef blob holds all C type table elements above the predefined types.
+** Header: magic, version, arch name, base ID, number of elements.
+** Element: hash kind, info, size, sib, name length+1, name (all ULEB128).
+** Type IDs >= base refer to elements in the blob and are relocated on load.
+*/
+
+#define CTDUMP_HEAD1		0x1b
+#define CTDUMP_HEAD2		0x4c
+#define CTDUMP_HEAD3		0x43
+#define CTDUMP_VERSION		1
+
+/* Hash kind of an element. */
+enum { CTDUMP_HNONE, CTDUMP_HNAME, CTDUMP_HTYPE };
+
+/* Namespaces for name clashes on load. Same as in the C parser. */
+#define CTDUMP_NSTAG	((1u<<CT_STRUCT)|(1u<<CT_ENUM))
+#define CTDUMP_NSIDENT \
+  ((1u<<CT_KW)|(1u<<CT_TYPEDEF)|(1u<<CT_FUNC)|(1u<<CT_EXTERN)|(1u<<CT_CONSTVAL))
+
+/* Check whether the cid field of a type info holds a type ID. */
+static int ctype_hascid(CTInfo info)
+{
+  switch (ctype_type(info)) {
+  case CT_PTR: case CT_ARRAY: case CT_ENUM: case CT_FUNC: case CT_TYPEDEF:
+  case CT_ATTRIB: case CT_FIELD: case CT_CONSTVAL: case CT_EXTERN:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/* Get the hash kind of a type element. */
+static int ctype_hashkind(CTState *cts, CTypeID id)
+{
+  CType *ct = ctype_get(cts, id);
+  GCobj *name = gcref(ct->name);
+  uint32_t h = name ? ct_hashname(name) : ct_hashtype(ct->info, ct->size);
+  CTypeID hid = cts->hash[h & cts->hmask];
+  while (hid) {
+    if (hid == id) return name ? CTDUMP_HNAME : CTDUMP_HTYPE;
+    hid = ctype_get(cts, hid)->next;
+  }
+  return CTDUMP_HNONE;
+}
+
+/* Serialize the C type table into a cdef blob. */
+GCstr *lj_ctype_save(CTState *cts)
+{
+  lua_State *L = cts->L;
+  SBuf *sb = lj_buf_tmp_(L);
+  CTypeID id;
+  MSize len = (MSize)strlen(LJ_ARCH_NAME);
+  char *p = lj_buf_more(sb, 4+5+len+5+5);
+  *p++ = CTDUMP_HEAD1; *p++ = CTDUMP_HEAD2; *p++ = CTDUMP_HEAD3;
+  *p++ = CTDUMP_VERSION;
+  p = lj_strfmt_wuleb128(p, len);
+  p = lj_buf_wmem(p, LJ_ARCH_NAME, len);
+  p = lj_strfmt_wuleb128(p, CTTYPEINFO_NUM);
+  p = lj_strfmt_wuleb128(p, cts->top - CTTYPEINFO_NUM);
+  setsbufP(sb, p);
+  for (id = CTTYPEINFO_NUM; id < cts->top; id++) {
+    CType *ct = ctype_get(cts, id);
+    GCstr *name = gcrefp(ct->name, GCstr);
+    len = name ? name->len : 0;
+    p = lj_buf_more(sb, 1+5+5+5+5+len);
+    *p++ = (char)ctype_hashkind(cts, id);
+    p = lj_strfmt_wuleb128(p, ct->info);
+    p = lj_strfmt_wuleb128(p, ct->size);
+    p = lj_strfmt_wuleb128(p, ct->sib);
+    if (name) {
+      p = lj_strfmt_wuleb128(p, len+1);
+      p = lj_buf_wmem(p, strdata(name), len);
+    } else {
+      *p++ = 0;
+    }
+    setsbufP(sb, p);
+  }
+  return lj_buf_str(L, sb);
+}
+
+/* State for loading a cdef blob. */
+typedef struct CTLoadState {
+  CTState *cts;
+  const char *p, *pe;	/* Current and end position in blob. */
+  CTypeID base;		/* First relocated type ID. */
+  MSize n;		/* Number of elements. */
+  CTypeID1 *map;	/* Map of blob index to type ID. */
+} CTLoadState;
+
+static LJ_NORET LJ_NOINLINE void ctload_err(CTLoadState *ls)
+{
+  lj_err_caller(ls->cts->L, LJ_ERR_FFI_BADCDEFS);
+}
+
+/* Read ULEB128 value. The string terminator stops overlong reads. */
+static uint32_t ctload_uleb128(CTLoadState *ls)
+{
+  uint32_t v;
+  if (ls->p >= ls->pe) ctload_err(ls);
+  v = lj_buf_ruleb128(&ls->p);
+  if (ls->p > ls->pe) ctload_err(ls);
+  return v;
+}
+
+/* Relocate a type ID. Only elements below lim may be referenced. */
+static CTypeID ctload_id(CTLoadState *ls, uint32_t id, MSize lim)
+{
+  if (id < ls->base) return id;
+  if (id - ls->base >= lim) ctload_err(ls);
+  return ls->map[id - ls->base];
+}
+
+/* Protected callback for cdef blob loader. */
+static TValue *cpctload(lua_State *L, lua_CFunction dummy, void *ud)
+{
+  CTLoadState *ls = (CTLoadState *)ud;
+  CTState *cts = ls->cts;
+  const char *p = ls->p;
+  MSize i;
+  UNUSED(dummy);
+  for (i = 0; i < ls->n; i++) {  /* Create all elements. */
+    CTypeID id;
+    int kind;
+    CTInfo info;
+    CTSize size;
+    MSize sib, len;
+    if (ls->p >= ls->pe) ctload_err(ls);
+    kind = (uint8_t)*ls->p++;
+    info = ctload_uleb128(ls);
+    size = ctload_uleb128(ls);
+    sib = ctload_uleb128(ls);
+    len = ctload_uleb128(ls);
+    if (kind > CTDUMP_HTYPE || ctype_type(info) >= CT_KW ||
+	(kind == CTDUMP_HNAME && !len) || (kind == CTDUMP_HTYPE && len))
+      ctload_err(ls);
+    if (kind == CTDUMP_HTYPE) {  /* Interned type: reuse an existing one. */
+      if (sib) ctload_err(ls);
+      if (ctype_hascid(info))
+	info = (info & ~CTMASK_CID) + ctload_id(ls, ctype_cid(info), i);
+      id = lj_ctype_intern(cts, info, size);
+    } else {
+      CType *ct;
+      id = lj_ctype_new(cts, &ct);
+      ct->info = info;  /* Relocated below. */
+      ct->size = size;
+      ct->sib = (CTypeID1)sib;
+      if (len) {
+	if (--len > (MSize)(ls->pe - ls->p)) ctload_err(ls);
+	ctype_setname(ct, lj_str_new(L, ls->p, len));
+	ls->p += len;
+      }
+    }
+    ls->map[i] = (CTypeID1)id;
+  }
+  if (ls->p != ls->pe) ctload_err(ls);
+  ls->p = p;
+  for (i = 0; i < ls->n; i++) {  /* Relocate and add names to hash table. */
+    CTypeID id = ls->map[i];
+    CType *ct = ctype_get(cts, id);
+    int kind = (uint8_t)*ls->p++;
+    MSize len;
+    ctload_uleb128(ls); ctload_uleb128(ls); ctload_uleb128(ls);
+    len = ctload_uleb128(ls);
+    ls->p += len ? len-1 : 0;
+    if (kind == CTDUMP_HTYPE) continue;
+    if (ctype_hascid(ct->info))
+      ct->info = (ct->info & ~CTMASK_CID) +
+		 ctload_id(ls, ctype_cid(ct->info), ls->n);
+    if (ct->sib) ct->sib = (CTypeID1)ctload_id(ls, ct->sib, ls->n);
+    if (kind == CTDUMP_HNAME) {
+      GCstr *name = gcrefp(ct->name, GCstr);
+      CType *cto;
+      if (ctype_isstruct(ct->info) || ctype_isenum(ct->info)) {
+	if (lj_ctype_getname(cts, &cto, name, CTDUMP_NSTAG))
+	  lj_err_callerv(L, LJ_ERR_FFI_REDEF, strdata(name));
+      } else if (lj_ctype_getname(cts, &cto, name, CTDUMP_NSIDENT)) {
+	continue;  /* Redeclarations are ignored, same as for ffi.cdef. */
+      }
+      lj_ctype_addname(cts, ct, id);
+    }
+  }
+  return NULL;
+}
+
+/* Load a cdef blob into the C type table. Returns 0 or an error code. */
+int lj_ctype_load(CTState *cts, GCstr *s)
+{
+  lua_State *L = cts->L;
+  CTLoadState ls;
+  int errcode;
+  MSize len;
+  ls.cts = cts;
+  ls.p = strdata(s);
+  ls.pe = ls.p + s->len;
+  if (s->len < 4 || ls.p[0] != CTDUMP_HEAD1 || ls.p[1] != CTDUMP_HEAD2 ||
+      ls.p[2] != CTDUMP_HEAD3 || ls.p[3] != CTDUMP_VERSION)
+    ctload_err(&ls);
+  ls.p += 4;
+  len = ctload_uleb128(&ls);
+  if (len != strlen(LJ_ARCH_NAME) || len > (MSize)(ls.pe - ls.p) ||
+      memcmp(ls.p, LJ_ARCH_NAME, len))
+    ctload_err(&ls);
+  ls.p += len;
+  ls.base = ctload_uleb128(&ls);
+  ls.n = ctload_uleb128(&ls);
+  if (ls.base != CTTYPEINFO_NUM || ls.n > CTID_MAX - cts->top)
+    ctload_err(&ls);
+  ls.map = (CTypeID1 *)lj_buf_tmp(L, ls.n*(MSize)sizeof(CTypeID1));
+  {
+    LJ_CTYPE_SAVE(cts);
+    errcode = lj_vm_cpcall(L, NULL, &ls, cpctload);
+    if (errcode)
+      LJ_CTYPE_RESTORE(cts);
+  }
+  return errcode;
+}
+
 /* -- C type state -------------------------------------------------------- */
 
 /* Initialize C type table and state. */
@@ -599,6 +872,9 @@ CTState *lj_ctype_init(lua_State *L)
   memset(cts, 0, sizeof(CTState));
   cts->tab = ct;
   cts->sizetab = CTTYPETAB_MIN;
+  cts->hash = lj_mem_newvec(L, CTHASH_MIN, CTypeID1);
+  memset(cts->hash, 0, CTHASH_MIN*sizeof(CTypeID1));
+  cts->hmask = CTHASH_MIN-1;
   cts->top = CTTYPEINFO_NUM;
   cts->L = NULL;
   cts->g = G(L);
@@ -630,7 +906,12 @@ void lj_ctype_freestate(global_State *g)
   if (cts) {
     lj_ccallback_mcode_free(cts);
     lj_mem_freevec(g, cts->tab, cts->sizetab, CType);
+    lj_mem_freevec(g, cts->hash, cts->hmask+1, CTypeID1);
     lj_mem_freevec(g, cts->cb.cbid, cts->cb.sizeid, CTypeID1);
+    if (cts->cb.sig)
+      lj_mem_freevec(g, cts->cb.sig, CCALL_CBSIG_CACHE, CCallbackSig);
+    if (cts->sig)
+      lj_mem_freevec(g, cts->sig, CCALL_SIG_CACHE, CCallSig);
     lj_mem_freet(g, cts);
   }
 }
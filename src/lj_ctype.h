@@ -148,8 +148,7 @@ typedef struct CType {
   GCRef name;		/* Element name (GCstr). */
 } CType;
 
-#define CTHASH_SIZE	128	/* Number of hash anchors. */
-#define CTHASH_MASK	(CTHASH_SIZE-1)
+#define CTHASH_MIN	128	/* Initial number of hash anchors. */
 
 /* Simplify target-specific configuration. Checked in lj_ccall.h. */
 #define CCALL_MAX_GPR		8
@@ -157,6 +156,45 @@ typedef struct CType {
 
 typedef LJ_ALIGN(8) union FPRCBArg { double d; float f[2]; } FPRCBArg;
 
+/* Precomputed conversion of a single callback argument. */
+typedef struct CCallbackArg {
+  uint8_t kind;			/* Conversion kind (CBARG_*). */
+  uint8_t ofs;			/* Offset into saved registers or stack. */
+  CTypeID1 id;			/* Raw argument type. */
+} CCallbackArg;
+
+/* Precomputed argument layout and conversions for a callback signature. */
+typedef struct CCallbackSig {
+  CTypeID1 id;			/* Function type or 0 for an unused entry. */
+  uint8_t narg;			/* Number of arguments. */
+  uint8_t nsp;			/* Number of stack slots used by arguments. */
+  CCallbackArg arg[LUA_MINSTACK-3];  /* Argument conversions. */
+} CCallbackSig;
+
+/* Precomputed slot and conversion of a single C call argument. */
+typedef struct CCallSigArg {
+  uint8_t kind;			/* Conversion kind (CCARG_*). */
+  uint8_t unused;
+  uint16_t ofs;			/* Offset of argument slot in CCallState. */
+  CTypeID1 id;			/* Raw argument type. */
+} CCallSigArg;
+
+#define CCALL_SIG_NARG		8	/* Max. arguments in a cached signature. */
+#define CCALL_SIG_CACHE		64	/* Number of cached signatures. */
+#define CCALL_SIG_NONE		0xff	/* Signature not handled by the cache. */
+#define CCALL_CBSIG_CACHE	32	/* Number of cached callback signatures. */
+
+/* Precomputed argument layout for calls to a C function type. */
+typedef struct CCallSig {
+  CTypeID1 id;			/* Function type or 0 for an unused entry. */
+  uint8_t narg;			/* Number of arguments or CCALL_SIG_NONE. */
+  uint8_t nsp;			/* Number of stack slots used by arguments. */
+  uint8_t nfpr;			/* Number of arguments in FPRs. */
+  uint8_t rkind;		/* Result conversion kind (CCARG_*). */
+  CTypeID1 rid;			/* Raw result type. */
+  CCallSigArg arg[CCALL_SIG_NARG];  /* Argument slots and conversions. */
+} CCallSig;
+
 /* C callback state. Defined here, to avoid dragging in lj_ccall.h. */
 
 typedef LJ_ALIGN(8) struct CCallback {
@@ -168,6 +206,7 @@ typedef LJ_ALIGN(8) struct CCallback {
   MSize sizeid;			/* Size of callback type table. */
   MSize topid;			/* Highest unused callback type table slot. */
   MSize slot;			/* Current callback slot. */
+  CCallbackSig *sig;		/* Cache of callback signatures or NULL. */
 } CCallback;
 
 /* C type state. */
@@ -180,7 +219,10 @@ typedef struct CTState {
   GCtab *finalizer;	/* Map of cdata to finalizer. */
   GCtab *miscmap;	/* Map of -CTypeID to metatable and cb slot to func. */
   CCallback cb;		/* Temporary callback state. */
-  CTypeID1 hash[CTHASH_SIZE];  /* Hash anchors for C type table. */
+  CTypeID1 *hash;	/* Hash anchors for C type table. */
+  MSize hmask;		/* Hash mask (size of hash anchor array - 1). */
+  MSize hcount;		/* Number of elements in hash chains. */
+  CCallSig *sig;	/* Cache of C call signatures or NULL. */
 } CTState;
 
 #define CTINFO(ct, flags)	(((CTInfo)(ct) << CTSHIFT_NUM) + (flags))
@@ -390,10 +432,8 @@ static LJ_AINLINE CTState *ctype_cts(lua_State *L)
 }
 
 /* Save and restore state of C type table. */
-#define LJ_CTYPE_SAVE(cts)	CTState savects_ = *(cts)
-#define LJ_CTYPE_RESTORE(cts) \
-  ((cts)->top = savects_.top, \
-   memcpy((cts)->hash, savects_.hash, sizeof(savects_.hash)))
+#define LJ_CTYPE_SAVE(cts)	CTypeID savetop_ = (cts)->top
+#define LJ_CTYPE_RESTORE(cts)	lj_ctype_rollback((cts), savetop_)
 
 /* Check C type ID for validity when assertions are enabled. */
 static LJ_AINLINE CTypeID ctype_check(CTState *cts, CTypeID id)
@@ -447,6 +487,7 @@ static LJ_AINLINE void ctype_setname(CType *ct, GCstr *s)
 LJ_FUNC CTypeID lj_ctype_new(CTState *cts, CType **ctp);
 LJ_FUNC CTypeID lj_ctype_intern(CTState *cts, CTInfo info, CTSize size);
 LJ_FUNC void lj_ctype_addname(CTState *cts, CType *ct, CTypeID id);
+LJ_FUNC void lj_ctype_rollback(CTState *cts, CTypeID top);
 LJ_FUNC CTypeID lj_ctype_getname(CTState *cts, CType **ctp, GCstr *name,
 				 uint32_t tmask);
 LJ_FUNC CType *lj_ctype_getfieldq(CTState *cts, CType *ct, GCstr *name,
@@ -461,6 +502,8 @@ LJ_FUNC cTValue *lj_ctype_meta(CTState *cts, CTypeID id, MMS mm);
 LJ_FUNC GCstr *lj_ctype_repr(lua_State *L, CTypeID id, GCstr *name);
 LJ_FUNC GCstr *lj_ctype_repr_int64(lua_State *L, uint64_t n, int isunsigned);
 LJ_FUNC GCstr *lj_ctype_repr_complex(lua_State *L, void *sp, CTSize size);
+LJ_FUNC GCstr *lj_ctype_save(CTState *cts);
+LJ_FUNC int lj_ctype_load(CTState *cts, GCstr *s);
 LJ_FUNC CTState *lj_ctype_init(lua_State *L);
 LJ_FUNC void lj_ctype_freestate(global_State *g);
 
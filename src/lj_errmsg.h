@@ -82,6 +82,8 @@ ERRDEF(COSUSP,	"cannot resume non-suspended coroutine")
 ERRDEF(TABINS,	"wrong number of arguments to " LUA_QL("insert"))
 ERRDEF(TABCAT,	"invalid value (%s) at index %d in table for " LUA_QL("concat"))
 ERRDEF(TABSORT,	"invalid order function for sorting")
+ERRDEF(TABMOVE,	"too many elements to move")
+ERRDEF(TABWRAP,	"destination wrap around")
 ERRDEF(IOCLFL,	"attempt to use a closed file")
 ERRDEF(IOSTDCL,	"standard file is closed")
 ERRDEF(OSUNIQF,	"unable to generate a unique filename")
@@ -161,6 +163,7 @@ ERRDEF(FFI_BADSCL,	"bad storage class")
 ERRDEF(FFI_DECLSPEC,	"declaration specifier expected")
 ERRDEF(FFI_BADTAG,	"undeclared or implicit tag " LUA_QS)
 ERRDEF(FFI_REDEF,	"attempt to redefine " LUA_QS)
+ERRDEF(FFI_BADCDEFS,	"bad or incompatible cdef blob")
 ERRDEF(FFI_NUMPARAM,	"wrong number of type parameters")
 ERRDEF(FFI_INITOV,	"too many initializers for " LUA_QS)
 ERRDEF(FFI_BADCONV,	"cannot convert " LUA_QS " to " LUA_QS)
@@ -183,6 +186,8 @@ ERRDEF(FFI_CBACKOV,	"no support for callbacks on this OS")
 #else
 ERRDEF(FFI_CBACKOV,	"too many callbacks")
 #endif
+ERRDEF(FFI_ARENAOV,	"not enough memory in arena")
+ERRDEF(FFI_TYPEOV,	"too many C types")
 ERRDEF(FFI_NYIPACKBIT,	"NYI: packed bit fields")
 ERRDEF(FFI_NYICALL,	"NYI: cannot call this C function (yet)")
 #endif
@@ -1153,6 +1153,222 @@ static void LJ_FASTCALL recff_table_clear(jit_State *J, RecordFFData *rd)
   }  /* else: Interpreter will throw. */
 }
 
+/* Check for a metamethod, which forces table.move/fill onto the slow path. */
+static int recff_table_hasmm(jit_State *J, TRef tr, cTValue *tv, MMS mm)
+{
+  RecordIndex ix;
+  ix.tab = tr;
+  copyTV(J->L, &ix.tabv, tv);
+  return lj_record_mm_lookup(J, &ix, mm);
+}
+
+static void LJ_FASTCALL recff_table_move(jit_State *J, RecordFFData *rd)
+{
+  TRef src = J->base[0], dst = src;
+  cTValue *dstv = &rd->argv[0];
+  if (!(src && J->base[1] && J->base[2] && J->base[3]))
+    return;  /* Interpreter will throw. */
+  if (J->base[4] && !tref_isnil(J->base[4])) {
+    dst = J->base[4];
+    dstv = &rd->argv[4];
+  }
+  if (tref_istab(src) && tref_istab(dst)) {
+    TRef trf = lj_opt_narrow_toint(J, J->base[1]);
+    TRef tre = lj_opt_narrow_toint(J, J->base[2]);
+    TRef trt = lj_opt_narrow_toint(J, J->base[3]);
+    TRef tr;
+    if (recff_table_hasmm(J, src, &rd->argv[0], MM_index) ||
+	recff_table_hasmm(J, dst, dstv, MM_newindex)) {
+      recff_nyiu(J, rd);
+      return;
+    }
+    tr = lj_ir_call(J, IRCALL_lj_tab_move, src, trf, tre, trt, dst);
+    /* Bad range: exit to the interpreter, which throws. */
+    emitir(IRTG(IR_NE, IRT_PTR), tr, lj_ir_kptr(J, NULL));
+    J->base[0] = dst;
+    J->needsnap = 1;
+  }  /* else: Interpreter will throw. */
+}
+
+static void LJ_FASTCALL recff_table_fill(jit_State *J, RecordFFData *rd)
+{
+  TRef tab = J->base[0], val = J->base[1];
+  if (tref_istab(tab) && val) {
+    TRef tri = (J->base[2] && !tref_isnil(J->base[2])) ?
+	       lj_opt_narrow_toint(J, J->base[2]) : lj_ir_kint(J, 1);
+    TRef tre;
+    if (!(tref_isnumber(val) || tref_ispri(val)) ||
+	recff_table_hasmm(J, tab, &rd->argv[0], MM_newindex)) {
+      recff_nyiu(J, rd);  /* NYI: filling with GC objects. */
+      return;
+    }
+    if (J->base[2] && J->base[3] && !tref_isnil(J->base[3])) {
+      tre = lj_opt_narrow_toint(J, J->base[3]);
+    } else if (!recff_table_hasmm(J, tab, &rd->argv[0], MM_len)) {
+      tre = emitir(IRTI(IR_ALEN), tab, TREF_NIL);
+    } else {
+      recff_nyiu(J, rd);  /* NYI: __len for the default end. */
+      return;
+    }
+    if (tref_isnumber(val))
+      lj_ir_call(J, IRCALL_lj_tab_fillnum, tab, tri, tre, lj_ir_tonum(J, val));
+    else
+      lj_ir_call(J, IRCALL_lj_tab_fillpri, tab, tri, tre,
+		 lj_ir_kint(J, (int32_t)tref_type(val)));
+    rd->nres = 0;
+    J->needsnap = 1;
+  }  /* else: Interpreter will throw. */
+}
+
+/* -- Typed arrays -------------------------------------------------------- */
+
+/* Get typed array header and its length. Returns NULL if the interpreter
+** will throw.
+*/
+static TypedArray *recff_tarr(jit_State *J, RecordFFData *rd,
+			      TRef *trta, TRef *trlen)
+{
+  TRef tr = J->base[0];
+  GCudata *ud;
+  if (!(tref_isudata(tr) && udistarr(udataV(&rd->argv[0]))))
+    return NULL;
+  ud = udataV(&rd->argv[0]);
+  /* Specialize to the element type. */
+  *trta = emitir(IRT(IR_FLOAD, IRT_U8), tr, IRFL_UDATA_UDTYPE);
+  emitir(IRTGI(IR_EQ), *trta, lj_ir_kint(J, ud->udtype));
+  *trta = emitir(IRT(IR_ADD, IRT_PTR), tr, lj_ir_kintp(J, sizeof(GCudata)));
+  *trlen = emitir(IRTI(IR_XLOAD), *trta, IRXLOAD_READONLY);
+  return (TypedArray *)uddata(ud);
+}
+
+/* Guard index against the length. Returns element pointer or 0 if the
+** index is out of range.
+*/
+static TRef recff_tarr_ref(jit_State *J, TypedArray *ta, uint32_t udtype,
+			   TRef trta, TRef trlen, TRef tri, int32_t k,
+			   uint8_t **pp)
+{
+  MSize esz = tarr_esize(udtype);
+  TRef tr = emitir(IRTI(IR_SUB), tri, lj_ir_kint(J, 1));
+  if ((MSize)(k-1) >= ta->len) {
+    emitir(IRTGI(IR_UGE), tr, trlen);
+    return 0;
+  }
+  emitir(IRTGI(IR_ULT), tr, trlen);
+  *pp = tarr_data(ta) + (MSize)(k-1) * esz;
+  tr = tri;
+#if LJ_64
+  tr = emitir(IRT(IR_CONV, IRT_INTP), tr, (IRT_INTP<<5)|IRT_INT|IRCONV_SEXT);
+#endif
+  if (esz > 1)
+    tr = emitir(IRT(IR_MUL, IRT_INTP), tr, lj_ir_kintp(J, esz));
+  tr = emitir(IRT(IR_ADD, IRT_PTR), tr, trta);
+  return emitir(IRT(IR_ADD, IRT_PTR), tr,
+		lj_ir_kintp(J, (ptrdiff_t)sizeof(TypedArray) - (ptrdiff_t)esz));
+}
+
+/* Load element without a type check. */
+static TRef recff_tarr_get(jit_State *J, uint32_t udtype, TRef trp, uint8_t *p)
+{
+  switch (udtype) {
+  case UDTYPE_TARR_F64: return emitir(IRT(IR_XLOAD, IRT_NUM), trp, 0);
+  case UDTYPE_TARR_I32: return emitir(IRTI(IR_XLOAD), trp, 0);
+  case UDTYPE_TARR_U8: return emitir(IRT(IR_XLOAD, IRT_U8), trp, 0);
+  default: {
+    TRef tr = emitir(IRT(IR_XLOAD, IRT_U8), trp, 0);
+    emitir(IRTGI(*p ? IR_NE : IR_EQ), tr, lj_ir_kint(J, 0));
+    return *p ? TREF_TRUE : TREF_FALSE;
+    }
+  }
+}
+
+static void LJ_FASTCALL recff_tarr_index(jit_State *J, RecordFFData *rd)
+{
+  TRef trta, trlen, tri = J->base[1], trp;
+  TypedArray *ta = recff_tarr(J, rd, &trta, &trlen);
+  uint32_t udtype;
+  uint8_t *p;
+  int32_t k;
+  if (!ta || !tri) return;  /* Interpreter will throw. */
+  udtype = udataV(&rd->argv[0])->udtype;
+  if (!tref_isnumber(tri)) {  /* Other keys are never found. */
+    if (rd->data == 0) J->base[0] = TREF_NIL;
+    return;  /* Else interpreter will throw. */
+  }
+  if (tvisint(&rd->argv[1])) {
+    k = intV(&rd->argv[1]);
+  } else {
+    lua_Number n = numV(&rd->argv[1]);
+    k = lj_num2int(n);
+    if (n != (lua_Number)k) {  /* NYI: non-integer keys. */
+      recff_nyiu(J, rd);
+      return;
+    }
+  }
+  tri = lj_opt_narrow_index(J, tri);
+  trp = recff_tarr_ref(J, ta, udtype, trta, trlen, tri, k, &p);
+  if (rd->data == 0) {  /* __index */
+    J->base[0] = trp ? recff_tarr_get(J, udtype, trp, p) : TREF_NIL;
+  } else if (trp && J->base[2]) {  /* __newindex */
+    TRef tr = J->base[2];
+    if (udtype == UDTYPE_TARR_BOOL) {
+      if (!tref_isbool(tr)) return;  /* Interpreter will throw. */
+      emitir(IRT(IR_XSTORE, IRT_U8), trp, lj_ir_kint(J, tref_istrue(tr)));
+    } else {
+      if (!tref_isnumber(tr)) return;  /* Interpreter will throw. */
+      if (udtype == UDTYPE_TARR_F64) {
+	emitir(IRT(IR_XSTORE, IRT_NUM), trp, lj_ir_tonum(J, tr));
+      } else {
+	tr = lj_opt_narrow_toint(J, tr);
+	emitir(IRT(IR_XSTORE, udtype == UDTYPE_TARR_I32 ? IRT_INT : IRT_U8),
+	       trp, tr);
+      }
+    }
+    rd->nres = 0;
+    J->needsnap = 1;
+  }  /* else: Interpreter will throw. */
+}
+
+static void LJ_FASTCALL recff_tarr_len(jit_State *J, RecordFFData *rd)
+{
+  TRef trta, trlen;
+  if (recff_tarr(J, rd, &trta, &trlen))
+    J->base[0] = trlen;
+}
+
+static void LJ_FASTCALL recff_tarr_ipairs_aux(jit_State *J, RecordFFData *rd)
+{
+  TRef trta, trlen, tri = J->base[1], trp;
+  TypedArray *ta = recff_tarr(J, rd, &trta, &trlen);
+  uint32_t udtype;
+  uint8_t *p;
+  if (!ta || !tri) return;  /* Interpreter will throw. */
+  if (!tvisnumber(&rd->argv[1]))  /* No support for string coercion. */
+    lj_trace_err(J, LJ_TRERR_BADTYPE);
+  udtype = udataV(&rd->argv[0])->udtype;
+  tri = emitir(IRTI(IR_ADD), lj_opt_narrow_toint(J, tri), lj_ir_kint(J, 1));
+  trp = recff_tarr_ref(J, ta, udtype, trta, trlen, tri,
+		       lj_num2int(numberVnum(&rd->argv[1]))+1, &p);
+  if (trp) {
+    J->base[0] = tri;
+    J->base[1] = recff_tarr_get(J, udtype, trp, p);
+    rd->nres = 2;
+  } else {
+    rd->nres = 0;
+  }
+}
+
+static void LJ_FASTCALL recff_tarr_ipairs(jit_State *J, RecordFFData *rd)
+{
+  TRef trta, trlen, tr = J->base[0];
+  if (recff_tarr(J, rd, &trta, &trlen)) {
+    J->base[0] = lj_ir_kfunc(J, funcV(&J->fn->c.upvalue[0]));
+    J->base[1] = tr;
+    J->base[2] = lj_ir_kint(J, 0);
+    rd->nres = 3;
+  }
+}
+
 /* -- I/O library fast functions ------------------------------------------ */
 
 /* Get FILE* for I/O function. Any I/O error aborts recording, so there's
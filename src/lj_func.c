@@ -23,6 +23,10 @@
 
 void LJ_FASTCALL lj_func_freeproto(global_State *g, GCproto *pt)
 {
+#if LJ_HASJIT
+  if (G2J(g)->nwarmpc)
+    lj_trace_warmfree(g, pt);
+#endif
   lj_mem_free(g, pt, pt->sizept);
 }
 
@@ -199,6 +199,7 @@ IRFPMDEF(FPMENUM)
   _(TAB_NODE,	offsetof(GCtab, node)) \
   _(TAB_ASIZE,	offsetof(GCtab, asize)) \
   _(TAB_HMASK,	offsetof(GCtab, hmask)) \
+  _(TAB_SHAPE,	offsetof(GCtab, shape)) \
   _(TAB_NOMM,	offsetof(GCtab, nomm)) \
   _(MS_LEVEL,   offsetof(MatchState, level)) \
   _(MS_FINDRET1,offsetof(MatchState, findret1)) \
@@ -171,6 +171,10 @@ typedef struct CCallInfo {
   _(ANY,	lj_tab_newkey,		3,   S, PGC, CCI_L) \
   _(ANY,	lj_tab_len,		1,  FL, INT, 0) \
   _(ANY,	lj_tab_len_hint,	2,  FL, INT, 0) \
+  _(ANY,	lj_tab_move,		6,   S, PGC, CCI_L) \
+  _(ANY,	lj_tab_fillnum,		5,   S, NIL, CCI_L|XA_FP) \
+  _(ANY,	lj_tab_fillpri,		5,   S, NIL, CCI_L) \
+  _(ANY,	lj_meta_tgetchain,	3,   L, PGC, CCI_L) \
   _(ANY,	lj_gc_step_jit,		2,  FS, NIL, CCI_L) \
   _(ANY,	lj_gc_barrieruv,	2,  FS, NIL, 0) \
   _(ANY,	lj_mem_newgco,		2,  FS, PGC, CCI_L) \
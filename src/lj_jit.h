@@ -125,6 +125,9 @@
   _(\007, hotloop,	56)	/* # of iter. to detect a hot loop/call. */ \
   _(\007, hotexit,	10)	/* # of taken exits to start a side trace. */ \
   _(\007, tryside,	4)	/* # of attempts to compile a side trace. */ \
+  _(\011, burstmsec,	0)	/* Max. msec compiling per CPU second or 0. */ \
+  _(\005, reopt,	0)	/* Re-record loops whose control flow flipped. */ \
+  _(\016, reoptthreshold,	1)	/* # of hot loop entry exits to re-record. */ \
   \
   _(\012, instunroll,	4)	/* Max. unroll for instable loops. */ \
   _(\012, loopunroll,	15)	/* Max. unroll for loop ops in side traces. */ \
@@ -135,6 +138,11 @@
   _(\011, sizemcode,	JIT_P_sizemcode_DEFAULT) \
   /* Max. total size of all machine code areas (in KBytes). */ \
   _(\010, maxmcode,	512) \
+  \
+  /* Register eviction heuristic (JIT_RA_*): 0 = greedy, 1 = belady. */ \
+  _(\010, regalloc,	0) \
+  _(\011, vectorize,	0)	/* Vectorize stride-1 loops over FFI arrays. */ \
+  _(\003, pic,		8)	/* Max. # of __index chain shapes per site. */ \
   /* End of list. */
 
 enum {
@@ -147,6 +155,11 @@ JIT_PARAMDEF(JIT_PARAMENUM)
 #define JIT_PARAMSTR(len, name, value)	#len #name
 #define JIT_P_STRING	JIT_PARAMDEF(JIT_PARAMSTR)
 
+/* Values of the regalloc parameter. */
+#define JIT_RA_GREEDY	0	/* Evict the value defined first. */
+#define JIT_RA_BELADY	1	/* Evict the value used furthest away. */
+#define JIT_RA_STRING	"\6greedy\6belady"
+
 /* -- JIT engine data structures ------------------------------------------ */
 
 /* Trace compiler state. */
@@ -272,6 +285,7 @@ typedef struct GCtrace {
   MSize mcloop;		/* Offset of loop start in machine code. */
   uint16_t nchild;	/* Number of child traces (root trace only). */
   uint16_t spadjust;	/* Stack pointer adjustment (offset in bytes). */
+  uint16_t nspill;	/* Number of spill stores and reloads. */
   TraceNo1 traceno;	/* Trace number. */
   TraceNo1 link;	/* Linked trace (or self for loops). */
   TraceNo1 root;	/* Root trace of side trace (or 0 for root traces). */
@@ -280,7 +294,8 @@ typedef struct GCtrace {
   uint8_t sinktags;	/* Trace has SINK tags. */
   uint8_t topslot;	/* Top stack slot already checked to be allocated. */
   uint8_t linktype;	/* Type of link. */
-  uint8_t unused1;
+  uint8_t hotloopexits;	/* Hot exits before the loop (root only). */
+  uint8_t reopted;	/* Re-recorded after a control flow flip (root only). */
 #ifdef LUAJIT_USE_GDBJIT
   void *gdbjit_entry;	/* GDB JIT entry. */
 #endif
@@ -307,11 +322,32 @@ typedef struct HotPenalty {
   uint16_t reason;	/* Abort reason (really TraceErr). */
 } HotPenalty;
 
+/* Warm start hint for the starting bytecode of a root trace. */
+typedef struct TraceWarm {
+  uint32_t chunkhash;	/* Hash of the chunk name. */
+  uint32_t bchash;	/* Hash of the (unpatched) bytecode of the prototype. */
+  BCLine firstline;	/* First line of the prototype. */
+  BCPos pos;		/* Bytecode position of the trace start. */
+} TraceWarm;
+
 #define PENALTY_SLOTS	64	/* Penalty cache slot. Must be a power of 2. */
 #define PENALTY_MIN	(36*2)	/* Minimum penalty value. */
 #define PENALTY_MAX	60000	/* Maximum penalty value. */
 #define PENALTY_RNDBITS	4	/* # of random bits to add to penalty value. */
 
+/* Inline cache of the __index chain shapes seen at a TGETS site.
+** Filled by the interpreter, read by the recorder.
+*/
+#define PIC_SLOTS	64	/* Inline cache sites. Must be a power of 2. */
+#define PIC_WAYS	8	/* Max. # of shapes recorded per site. */
+#define PIC_SLOT(pc)	((u32ptr(pc) >> 2) & (PIC_SLOTS-1))
+
+typedef struct PICSite {
+  MRef pc;		/* Bytecode PC of the TGETS. */
+  uint32_t nsig;	/* # of shapes seen, PIC_WAYS+1 on overflow. */
+  uint32_t sig[PIC_WAYS];  /* Signatures of the shapes seen so far. */
+} PICSite;
+
 /* Round-robin backpropagation cache for narrowing conversions. */
 typedef struct BPropEntry {
   IRRef1 key;		/* Key: original reference. */
@@ -455,6 +491,8 @@ typedef struct jit_State {
   SnapShot *snapbuf;	/* Temp. snapshot buffer. */
   SnapEntry *snapmapbuf;  /* Temp. snapshot map buffer. */
   MSize sizesnapmap;	/* Size of temp. snapshot map buffer. */
+  IRRef1 *usebuf;	/* Temp. use chain buffer for regalloc=belady. */
+  MSize sizeuse;	/* Size of temp. use chain buffer. */
 
   PostProc postproc;	/* Required post-processing after execution. */
 #if LJ_SOFTFP32 || (LJ_32 && LJ_HASFFI)
@@ -476,8 +514,22 @@ typedef struct jit_State {
 
   HotPenalty penalty[PENALTY_SLOTS];  /* Penalty slots. */
   uint32_t penaltyslot;	/* Round-robin index into penalty slots. */
+  MRef reoptpc;		/* Start PC of a flushed loop pending re-recording. */
+
+  PICSite pic[PIC_SLOTS];  /* Inline caches for __index chains. */
+
+  TraceWarm *warm;	/* Warm start hints, hashed by prototype identity. */
+  MSize warmmask;	/* Hash mask of warm start hints (size-1). */
+  MSize nwarm;		/* Number of warm start hints. */
+  const BCIns **warmpc;	/* Hinted start PCs of loaded prototypes, sorted. */
+  MSize nwarmpc;	/* Number of hinted start PCs. */
+  MSize sizewarmpc;	/* Size of hinted start PC vector. */
+  uint64_t warmarmed;	/* Hotcount slots armed for a hinted start PC. */
+
+  uint32_t burstclock;	/* Start of current compile budget window (usec). */
+  uint32_t burstused;	/* Compile time used in current window (usec). */
 
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
   RBCHashEntry rbchash[RBCHASH_SLOTS];  /* Reverse bytecode map. */
 #endif
 
@@ -22,6 +22,7 @@
 #include "lj_lex.h"
 #include "lj_bcdump.h"
 #include "lj_parse.h"
+#include "lj_trace.h"
 
 /* -- Load Lua source code and bytecode ----------------------------------- */
 
@@ -39,6 +40,10 @@ static TValue *cpparser(lua_State *L, lua_CFunction dummy, void *ud)
     lj_err_throw(L, LUA_ERRSYNTAX);
   }
   pt = bc ? lj_bcread(ls) : lj_parse(ls);
+#if LJ_HASJIT
+  if (L2J(L)->nwarm)
+    lj_trace_warm(L, pt);
+#endif
   fn = lj_func_newL_empty(L, pt, NULL);
   /* Don't combine above/below into one statement. */
   setfuncV(L, L->top++, fn);
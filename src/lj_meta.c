@@ -19,6 +19,7 @@
 #include "lj_frame.h"
 #include "lj_bc.h"
 #include "lj_vm.h"
+#include "lj_dispatch.h"
 #include "lj_strscan.h"
 #include "lj_strfmt.h"
 #include "lj_lib.h"
@@ -132,19 +133,104 @@ static TValue *mmcall(lua_State *L, ASMFunction cont, cTValue *mo,
 
 /* -- C helpers for some instructions, called from assembler VM ----------- */
 
+#if LJ_HASJIT
+/* Remember the shape of an __index chain at a TGETS site. The signature
+** covers what the recorder specializes the chain on: the # of levels and
+** the hash slots of the key and of __index at each level. It's computed
+** by lj_meta_tget() while walking the chain, so only a miss costs extra.
+*/
+static void meta_pic_update(lua_State *L, cTValue *o, cTValue *k,
+			    uint32_t sig)
+{
+  const BCIns *pc;
+  PICSite *pic;
+  MSize i;
+  if (!tvistab(o) || !tvisstr(k) || !curr_funcisL(L) ||
+      !(G2J(G(L))->flags & JIT_F_ON))
+    return;
+  pc = cframe_Lpc(L) - 1;
+  if (bc_op(*pc) != BC_TGETS) return;  /* Not called from TGETS. */
+  pic = &G2J(G(L))->pic[PIC_SLOT(pc)];
+  if (mref(pic->pc, const BCIns) != pc) {  /* Take over the slot. */
+    setmref(pic->pc, pc);
+    pic->nsig = 0;
+  }
+  for (i = 0; i < pic->nsig && i < PIC_WAYS; i++)
+    if (pic->sig[i] == sig)
+      return;  /* Signature hit. */
+  if (pic->nsig < PIC_WAYS)
+    pic->sig[pic->nsig] = sig;
+  if (pic->nsig <= PIC_WAYS)
+    pic->nsig++;
+}
+
+/* Inlined lj_tab_getstr(), since it's called for every level. */
+static LJ_AINLINE cTValue *meta_getstr(GCtab *t, GCstr *key)
+{
+  Node *n = &noderef(t->node)[key->sid & t->hmask];
+  do {
+    if (tvisstr(&n->key) && strV(&n->key) == key)
+      return &n->val;
+  } while ((n = nextnode(n)));
+  return NULL;
+}
+
+/* Resolve an __index chain made up of tables only. Called from traces.
+** Returns niltv if the chain ends in nil, a function or is too long.
+*/
+cTValue *lj_meta_tgetchain(lua_State *L, GCtab *t, GCstr *k)
+{
+  GCstr *name = mmname_str(G(L), MM_index);
+  int loop;
+  for (loop = 0; loop < LJ_MAX_IDXCHAIN; loop++) {
+    cTValue *tv = meta_getstr(t, k);
+    GCtab *mt = tabref(t->metatable);
+    if (tv && !tvisnil(tv))
+      return tv;
+    if (!mt || (mt->nomm & (1u<<MM_index)) ||
+	!(tv = meta_getstr(mt, name)) || !tvistab(tv))
+      break;
+    t = tabV(tv);
+  }
+  return niltv(L);
+}
+#endif
+
 /* Helper for TGET*. __index chain and metamethod. */
 cTValue *lj_meta_tget(lua_State *L, cTValue *o, cTValue *k)
 {
   int loop;
   cTValue *origo = o;
+#if LJ_HASJIT
+  uint32_t sig = 0;  /* Shape signature of a chain made up of tables. */
+  int tabchain = 1;
+#endif
   for (loop = 0; loop < LJ_MAX_IDXCHAIN; loop++) {
     cTValue *mo;
     if (LJ_LIKELY(tvistab(o))) {
       GCtab *t = tabV(o);
       cTValue *tv = lj_tab_get(L, t, k);
+#if LJ_HASJIT
+      sig = sig*31 + t->hmask;
+      if (tvisstr(k) && tv != niltv(L))
+	sig = sig*31 + (uint32_t)((Node *)tv - noderef(t->node));
+#endif
       if (!tvisnil(tv) ||
-	  !(mo = lj_meta_fast(L, tabref(t->metatable), MM_index)))
+	  !(mo = lj_meta_fast(L, tabref(t->metatable), MM_index))) {
+#if LJ_HASJIT
+	if (o != origo && tabchain) meta_pic_update(L, origo, k, sig);
+#endif
 	return tv;
+      }
+#if LJ_HASJIT
+      if (tvistab(mo)) {
+	GCtab *mt = tabref(t->metatable);
+	sig = sig*31 + mt->hmask;
+	sig = sig*31 + (uint32_t)((Node *)mo - noderef(mt->node));
+      } else {
+	tabchain = 0;
+      }
+#endif
     } else if (tvisnil(mo = lj_meta_lookup(L, o, MM_index))) {
       lj_err_optype(L, o, LJ_ERR_OPINDEX);
       return NULL;  /* unreachable */
@@ -34,5 +34,8 @@ LJ_FUNCA TValue *lj_meta_comp(lua_State *L, cTValue *o1, cTValue *o2, int op);
 LJ_FUNCA void lj_meta_istype(lua_State *L, BCReg ra, BCReg tp);
 LJ_FUNCA void lj_meta_call(lua_State *L, TValue *func, TValue *top);
 LJ_FUNCA void LJ_FASTCALL lj_meta_for(lua_State *L, TValue *o);
+#if LJ_HASJIT
+LJ_FUNC cTValue *lj_meta_tgetchain(lua_State *L, GCtab *t, GCstr *k);
+#endif
 
 #endif
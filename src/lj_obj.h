@@ -347,11 +347,18 @@ enum {
   UDTYPE_USERDATA,	/* Regular userdata. */
   UDTYPE_IO_FILE,	/* I/O library FILE. */
   UDTYPE_FFI_CLIB,	/* FFI C library namespace. */
+  UDTYPE_FFI_ARENA,	/* FFI arena for bump allocation. */
+  UDTYPE_TARR_F64,	/* table.typed() array of double. ORDER TARR. */
+  UDTYPE_TARR_I32,	/* table.typed() array of int32_t. */
+  UDTYPE_TARR_U8,	/* table.typed() array of uint8_t. */
+  UDTYPE_TARR_BOOL,	/* table.typed() array of bool. */
   UDTYPE__MAX
 };
 
 #define uddata(u)	((void *)((u)+1))
 #define sizeudata(u)	(sizeof(struct GCudata)+(u)->len)
+#define udistarr(u) \
+  ((uint32_t)((u)->udtype - UDTYPE_TARR_F64) <= UDTYPE_TARR_BOOL-UDTYPE_TARR_F64)
 
 /* -- C data object ------------------------------------------------------- */
 
@@ -524,6 +531,9 @@ typedef struct GCtab {
   GCHeader;
   uint8_t nomm;		/* Negative cache for fast metamethods. */
   int8_t colo;		/* Array colocation. */
+#if LJ_GC64
+  MSize lenhint;	/* Last computed length. Verified before use. */
+#endif
   MRef array;		/* Array part. Aliases env. */
   GCRef gclist;
   GCRef metatable;	/* Must be at same offset in GCudata. */
@@ -532,6 +542,11 @@ typedef struct GCtab {
   uint32_t hmask;	/* Hash part mask (size of hash part - 1). */
 #if LJ_GC64
   MRef freetop;		/* Top of free elements. */
+  uint32_t shape;	/* Shape of the hash part or 0. See lj_tab_dup(). */
+  uint32_t align1;	/* Keep colocated arrays 8 byte aligned. */
+#else
+  MSize lenhint;	/* Last computed length. Verified before use. */
+  uint32_t shape;	/* Shape of the hash part or 0. See lj_tab_dup(). */
 #endif
 } GCtab;
 
@@ -689,6 +704,7 @@ typedef struct global_State {
   MRef jit_base;	/* Current JIT code L->base or NULL. */
   MRef ctype_state;	/* Pointer to C type state. */
   PRNGState prng;	/* Global PRNG state. */
+  uint32_t tabshape;	/* Last table shape handed out by lj_tab_dup(). */
   GCRef gcroot[GCROOT_MAX];  /* GC roots. */
   MatchState ms;        /* Capture buffer for JIT mcode. */
   const void *cframe_limit; /* CPU stack overflows below this. */
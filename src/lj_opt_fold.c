@@ -2237,11 +2237,22 @@ LJFOLDF(fload_tab_tdup_hmask)
   return NEXTFOLD;
 }
 
+LJFOLD(FLOAD TDUP IRFL_TAB_SHAPE)
+LJFOLDF(fload_tab_tdup_shape)
+{
+  uint32_t shape = ir_ktab(IR(fleft->op1))->shape;
+  if (LJ_LIKELY(J->flags & JIT_F_OPT_FOLD) && shape &&
+      lj_opt_fwd_tptr(J, fins->op1))
+    return INTFOLD((int32_t)shape);
+  return NEXTFOLD;
+}
+
 LJFOLD(HREF any any)
 LJFOLD(FLOAD any IRFL_TAB_ARRAY)
 LJFOLD(FLOAD any IRFL_TAB_NODE)
 LJFOLD(FLOAD any IRFL_TAB_ASIZE)
 LJFOLD(FLOAD any IRFL_TAB_HMASK)
+LJFOLD(FLOAD any IRFL_TAB_SHAPE)
 LJFOLDF(fload_tab_ah)
 {
   TRef tr = lj_opt_cse(J);
@@ -81,6 +81,8 @@ static AliasRet aa_ahref(jit_State *J, IRIns *refa, IRIns *refb)
   IRRef ta, tb;
   if (refa == refb)
     return ALIAS_MUST;  /* Shortcut for same refs. */
+  if (refa->o == IR_CALLL || refb->o == IR_CALLL)
+    return ALIAS_MAY;  /* Result of an __index chain lookup. */
   keya = IR(ka);
   if (keya->o == IR_KSLOT) { ka = keya->op1; keya = IR(ka); }
   keyb = IR(kb);
@@ -130,6 +132,24 @@ static AliasRet aa_ahref(jit_State *J, IRIns *refa, IRIns *refb)
     return aa_table(J, ta, tb);  /* Try to disambiguate tables. */
 }
 
+/* Check whether there's no aliasing table.clear/move/fill. */
+static int fwd_aa_tab_clear(jit_State *J, IRRef lim, IRRef ta)
+{
+  IRRef ref = J->chain[IR_CALLS];
+  while (ref > lim) {
+    IRIns *calls = IR(ref);
+    if (calls->op2 == IRCALL_lj_tab_clear &&
+	(ta == calls->op1 || aa_table(J, ta, calls->op1) != ALIAS_NO))
+      return 0;  /* Conflict. */
+    if (calls->op2 == IRCALL_lj_tab_move ||
+	calls->op2 == IRCALL_lj_tab_fillnum ||
+	calls->op2 == IRCALL_lj_tab_fillpri)
+      return 0;  /* Conservatively assume a conflict with any table. */
+    ref = calls->prev;
+  }
+  return 1;  /* No conflict. Can safely FOLD/CSE. */
+}
+
 /* Array and hash load forwarding. */
 static TRef fwd_ahload(jit_State *J, IRRef xref)
 {
@@ -154,7 +174,8 @@ static TRef fwd_ahload(jit_State *J, IRRef xref)
     IRIns *ir = (xr->o == IR_HREFK || xr->o == IR_AREF) ? IR(xr->op1) : xr;
     IRRef tab = ir->op1;
     ir = IR(tab);
-    if (ir->o == IR_TNEW || (ir->o == IR_TDUP && irref_isk(xr->op2))) {
+    if ((ir->o == IR_TNEW || (ir->o == IR_TDUP && irref_isk(xr->op2))) &&
+	fwd_aa_tab_clear(J, tab, tab)) {
       /* A NEWREF with a number key may end up pointing to the array part.
       ** But it's referenced from HSTORE and not found in the ASTORE chain.
       ** For now simply consider this a conflict without forwarding anything.
@@ -279,7 +300,7 @@ TRef LJ_FASTCALL lj_opt_fwd_hrefk(jit_State *J)
     ref = newref->prev;
   }
   /* No conflicting NEWREF: key location unchanged for HREFK of TDUP. */
-  if (IR(tab)->o == IR_TDUP)
+  if (IR(tab)->o == IR_TDUP && fwd_aa_tab_clear(J, tab, tab))
     fins->t.irt &= ~IRT_GUARD;  /* Drop HREFK guard. */
 docse:
   return CSEFOLD;
@@ -310,21 +331,11 @@ int LJ_FASTCALL lj_opt_fwd_href_nokey(jit_State *J)
     ref = store->prev;
   }
 
-  return 1;  /* No conflict. Can fold to niltv. */
-}
+  /* table.move/fill may add numeric keys, too. */
+  if (irt_isnum(fright->t) && !fwd_aa_tab_clear(J, lim, lim))
+    return 0;  /* Conflict. */
 
-/* Check whether there's no aliasing table.clear. */
-static int fwd_aa_tab_clear(jit_State *J, IRRef lim, IRRef ta)
-{
-  IRRef ref = J->chain[IR_CALLS];
-  while (ref > lim) {
-    IRIns *calls = IR(ref);
-    if (calls->op2 == IRCALL_lj_tab_clear &&
-	(ta == calls->op1 || aa_table(J, ta, calls->op1) != ALIAS_NO))
-      return 0;  /* Conflict. */
-    ref = calls->prev;
-  }
-  return 1;  /* No conflict. Can safely FOLD/CSE. */
+  return 1;  /* No conflict. Can fold to niltv. */
 }
 
 /* Check whether there's no aliasing NEWREF/table.clear for the left operand. */
@@ -287,7 +287,7 @@ static void canonicalize_slots(jit_State *J)
 /* Stop recording. */
 void lj_record_stop(jit_State *J, TraceLink linktype, TraceNo lnk)
 {
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
   if (J->retryrec)
     lj_trace_err(J, LJ_TRERR_RETRY);
 #endif
@@ -1177,7 +1177,7 @@ static void rec_mm_comp_cdata(jit_State *J, RecordIndex *ix, int op, MMS mm)
 
 /* -- Indexed access ------------------------------------------------------ */
 
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
 /* Bump table allocations in bytecode when they grow during recording. */
 static void rec_idx_bump(jit_State *J, RecordIndex *ix)
 {
@@ -1282,6 +1282,13 @@ static void rec_idx_abc(jit_State *J, TRef asizeref, TRef ikey, uint32_t asize)
   emitir(IRTGI(IR_ABC), asizeref, ikey);  /* Emit regular bounds check. */
 }
 
+/* Guard on the shape of a table, i.e. the layout of its hash part. */
+static void rec_idx_shape(jit_State *J, TRef tab, GCtab *t)
+{
+  TRef tr = emitir(IRTI(IR_FLOAD), tab, IRFL_TAB_SHAPE);
+  emitir(IRTGI(IR_EQ), tr, lj_ir_kint(J, (int32_t)t->shape));
+}
+
 /* Record indexed key lookup. */
 static TRef rec_idx_key(jit_State *J, RecordIndex *ix, IRRef *rbref,
 			IRType1 *rbguard)
@@ -1340,14 +1347,25 @@ static TRef rec_idx_key(jit_State *J, RecordIndex *ix, IRRef *rbref,
     MSize hslot = (MSize)((char *)ix->oldv - (char *)&noderef(t->node)[0].val);
     if (t->hmask > 0 && hslot <= t->hmask*(MSize)sizeof(Node) &&
 	hslot <= 65535*(MSize)sizeof(Node)) {
-      TRef node, kslot, hm;
+      TRef node, kslot;
       *rbref = J->cur.nins;  /* Mark possible rollback point. */
       *rbguard = J->guardemit;
-      hm = emitir(IRTI(IR_FLOAD), ix->tab, IRFL_TAB_HMASK);
-      emitir(IRTGI(IR_EQ), hm, lj_ir_kint(J, (int32_t)t->hmask));
+      if (t->shape) {
+	rec_idx_shape(J, ix->tab, t);
+      } else {
+	TRef hm = emitir(IRTI(IR_FLOAD), ix->tab, IRFL_TAB_HMASK);
+	emitir(IRTGI(IR_EQ), hm, lj_ir_kint(J, (int32_t)t->hmask));
+      }
       node = emitir(IRT(IR_FLOAD, IRT_PGC), ix->tab, IRFL_TAB_NODE);
       kslot = lj_ir_kslot(J, key, hslot / sizeof(Node));
-      return emitir(IRTG(IR_HREFK, IRT_PGC), node, kslot);
+      /* The shape already implies the key in the slot. */
+      return emitir(t->shape ? IRT(IR_HREFK, IRT_PGC) : IRTG(IR_HREFK, IRT_PGC),
+		    node, kslot);
+    }
+    if (t->shape && ix->oldv == niltvg(J2G(J))) {
+      /* Nor can the key be present unless the shape changed. */
+      rec_idx_shape(J, ix->tab, t);
+      return lj_ir_kkptr(J, niltvg(J2G(J)));
     }
   }
   /* Fall back to a regular hash lookup. */
@@ -1371,6 +1389,35 @@ static int nommstr(jit_State *J, TRef key)
   return 1;  /* CANNOT be a metamethod name. */
 }
 
+/* Record an __index chain lookup at a polymorphic TGETS site.
+**
+** Specializing the chain emits guards on its length and on the hash slots
+** used at every level, so each chain shape gets its own side trace. That's
+** fine for a few shapes. If the interpreter has seen more shapes than the
+** pic parameter allows, a single call resolves the whole chain instead and
+** the trace works for all classes sharing the inherited value.
+*/
+static TRef rec_idx_chain(jit_State *J, RecordIndex *ix)
+{
+  PICSite *pic = &J->pic[PIC_SLOT(J->pc)];
+  GCtab *t = tabV(&ix->tabv);
+  GCstr *key = strV(&ix->keyv);
+  cTValue *tv = lj_tab_getstr(t, key);
+  IRType tp;
+  TRef tr;
+  if ((tv && !tvisnil(tv)) || !gcref(t->metatable) ||
+      mref(pic->pc, const BCIns) != J->pc ||
+      pic->nsig <= (uint32_t)J->param[JIT_P_pic])
+    return 0;  /* Raw hit, no metatable or few shapes at this site. */
+  tv = lj_meta_tgetchain(J->L, t, key);
+  if (tvisnil(tv))
+    return 0;  /* Leave nil results and __index functions to the slow path. */
+  tp = itype2irt(tv);
+  tr = lj_ir_call(J, IRCALL_lj_meta_tgetchain, ix->tab, ix->key);
+  tr = emitir(IRTG(IR_HLOAD, tp), tr, 0);
+  return irtype_ispri(tp) ? TREF_PRI(tp) : tr;
+}
+
 /* Record indexed load/store. */
 TRef lj_record_idx(jit_State *J, RecordIndex *ix)
 {
@@ -1428,6 +1475,12 @@ TRef lj_record_idx(jit_State *J, RecordIndex *ix)
     }
   }
 
+  if (ix->val == 0 && ix->idxchain == LJ_MAX_IDXCHAIN &&
+      tref_isk(ix->key) && tref_isstr(ix->key) && bc_op(*J->pc) == BC_TGETS) {
+    TRef tr = rec_idx_chain(J, ix);
+    if (tr) return tr;
+  }
+
   /* Record the key lookup. */
   xref = rec_idx_key(J, ix, &rbref, &rbguard);
   xrefop = IR(tref_ref(xref))->o;
@@ -1482,7 +1535,7 @@ TRef lj_record_idx(jit_State *J, RecordIndex *ix)
 	  key = emitir(IRTN(IR_CONV), key, IRCONV_NUM_INT);
 	xref = emitir(IRT(IR_NEWREF, IRT_PGC), ix->tab, key);
 	keybarrier = 0;  /* NEWREF already takes care of the key barrier. */
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
 	if ((J->flags & JIT_F_OPT_SINK))  /* Avoid a separate flag. */
 	  rec_idx_bump(J, ix);
 #endif
@@ -1528,7 +1581,7 @@ static void rec_tsetm(jit_State *J, BCReg ra, BCReg rn, int32_t i)
   settabV(J->L, &ix.tabv, t);
   ix.tab = getslot(J, ra-1);
   ix.idxchain = 0;
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
   if ((J->flags & JIT_F_OPT_SINK)) {
     if (t->asize < i+rn-ra)
       lj_tab_reasize(J->L, t, i+rn-ra);
@@ -1879,7 +1932,7 @@ static TRef rec_tnew(jit_State *J, uint32_t ah)
   TRef tr;
   if (asize == 0x7ff) asize = 0x801;
   tr = emitir(IRTG(IR_TNEW, IRT_TAB), asize, hbits);
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
   J->rbchash[(tr & (RBCHASH_SLOTS-1))].ref = tref_ref(tr);
   setmref(J->rbchash[(tr & (RBCHASH_SLOTS-1))].pc, J->pc);
   setgcref(J->rbchash[(tr & (RBCHASH_SLOTS-1))].pt, obj2gco(J->pt));
@@ -2331,7 +2384,7 @@ void lj_record_ins(jit_State *J)
   case BC_TDUP:
     rc = emitir(IRTG(IR_TDUP, IRT_TAB),
 		lj_ir_ktab(J, gco2tab(proto_kgc(J->pt, ~(ptrdiff_t)rc))), 0);
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
     J->rbchash[(rc & (RBCHASH_SLOTS-1))].ref = tref_ref(rc);
     setmref(J->rbchash[(rc & (RBCHASH_SLOTS-1))].pc, pc);
     setgcref(J->rbchash[(rc & (RBCHASH_SLOTS-1))].pt, obj2gco(J->pt));
@@ -2565,7 +2618,7 @@ void lj_record_setup(jit_State *J)
   /* Initialize state related to current trace. */
   memset(J->slot, 0, sizeof(J->slot));
   memset(J->chain, 0, sizeof(J->chain));
-#ifdef LUAJIT_ENABLE_TABLE_BUMP
+#if LJ_HASTABBUMP
   memset(J->rbchash, 0, sizeof(J->rbchash));
 #endif
   memset(J->bpropcache, 0, sizeof(J->bpropcache));
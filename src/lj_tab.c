@@ -108,10 +108,12 @@ static GCtab *newtab(lua_State *L, uint32_t asize, uint32_t hbits)
     t->gct = ~LJ_TTAB;
     t->nomm = (uint8_t)~0;
     t->colo = (int8_t)asize;
+    t->lenhint = 0;
     setmref(t->array, (TValue *)((char *)t + sizeof(GCtab)));
     setgcrefnull(t->metatable);
     t->asize = asize;
     t->hmask = 0;
+    t->shape = 0;
     nilnode = &G(L)->nilnode;
     setmref(t->node, nilnode);
 #if LJ_GC64
@@ -123,10 +125,12 @@ static GCtab *newtab(lua_State *L, uint32_t asize, uint32_t hbits)
     t->gct = ~LJ_TTAB;
     t->nomm = (uint8_t)~0;
     t->colo = 0;
+    t->lenhint = 0;
     setmref(t->array, NULL);
     setgcrefnull(t->metatable);
     t->asize = 0;  /* In case the array allocation fails. */
     t->hmask = 0;
+    t->shape = 0;
     nilnode = &G(L)->nilnode;
     setmref(t->node, nilnode);
 #if LJ_GC64
@@ -180,7 +184,13 @@ GCtab * LJ_FASTCALL lj_tab_new1(lua_State *L, uint32_t ahsize)
 }
 #endif
 
-/* Duplicate a table. */
+/* Duplicate a table.
+**
+** All duplicates of a template share its shape, i.e. the same layout of
+** the hash part, until a key is added or the table is resized or cleared.
+** The JIT compiler guards on the shape once per table, instead of checking
+** the key of every hash slot it accesses.
+*/
 GCtab * LJ_FASTCALL lj_tab_dup(lua_State *L, const GCtab *kt)
 {
   GCtab *t;
@@ -189,6 +199,9 @@ GCtab * LJ_FASTCALL lj_tab_dup(lua_State *L, const GCtab *kt)
   lj_assertL(kt->asize == t->asize && kt->hmask == t->hmask,
 	     "mismatched size of table and template");
   t->nomm = 0;  /* Keys with metamethod names may be present. */
+  if (kt->shape == 0 && G(L)->tabshape != ~0u)  /* Never reuse a shape. */
+    ((GCtab *)kt)->shape = ++G(L)->tabshape;
+  t->shape = kt->shape;
   asize = kt->asize;
   if (asize > 0) {
     TValue *array = tvref(t->array);
@@ -223,6 +236,8 @@ GCtab * LJ_FASTCALL lj_tab_dup(lua_State *L, const GCtab *kt)
 /* Clear a table. */
 void LJ_FASTCALL lj_tab_clear(GCtab *t)
 {
+  t->lenhint = 0;
+  t->shape = 0;
   clearapart(t);
   if (t->hmask > 0) {
     Node *node = noderef(t->node);
@@ -252,6 +267,7 @@ void lj_tab_resize(lua_State *L, GCtab *t, uint32_t asize, uint32_t hbits)
   Node *oldnode = noderef(t->node);
   uint32_t oldasize = t->asize;
   uint32_t oldhmask = t->hmask;
+  t->shape = 0;
   if (asize > oldasize) {  /* Array part grows? */
     TValue *array;
     uint32_t i;
@@ -458,22 +474,50 @@ cTValue *lj_tab_get(lua_State *L, GCtab *t, cTValue *key)
 
 /* -- Table setters ------------------------------------------------------- */
 
+/*
+** Big hash parts first look for a free node right next to the main node.
+** Then a chain usually continues in the same or the following cache line,
+** instead of hopping to a node from the top of the free list. Nodes with
+** a nil key are never part of a chain, so they can be taken from anywhere
+** below the free top.
+*/
+#define HASH_NEAR_MINHMASK	1023	/* Min. hash mask for nearby nodes. */
+#define HASH_NEAR_PROBES	3	/* Number of nearby nodes to check. */
+
+static LJ_AINLINE Node *getfreenear(const GCtab *t, Node *n)
+{
+  Node *node = noderef(t->node);
+  uint32_t hmask = t->hmask, i = (uint32_t)(n - node), j;
+  for (j = 1; j <= HASH_NEAR_PROBES; j++) {
+    Node *f = &node[(i + j) & hmask];
+    if (tvisnil(&f->key))
+      return f;
+  }
+  return NULL;
+}
+
 /* Insert new key. Use Brent's variation to optimize the chain length. */
 TValue *lj_tab_newkey(lua_State *L, GCtab *t, cTValue *key)
 {
   Node *n = hashkey(t, key);
+  t->shape = 0;  /* May move other keys, too. */
   if (!tvisnil(&n->val) || t->hmask == 0) {
     Node *nodebase = noderef(t->node);
-    Node *collide, *freenode = getfreetop(t, nodebase);
-    lj_assertL(freenode >= nodebase && freenode <= nodebase+t->hmask+1,
-	       "bad freenode");
-    do {
-      if (freenode == nodebase) {  /* No free node found? */
-	rehashtab(L, t, key);  /* Rehash table. */
-	return lj_tab_set(L, t, key);  /* Retry key insertion. */
-      }
-    } while (!tvisnil(&(--freenode)->key));
-    setfreetop(t, nodebase, freenode);
+    Node *collide, *freenode = NULL;
+    if (t->hmask >= HASH_NEAR_MINHMASK)
+      freenode = getfreenear(t, n);
+    if (!freenode) {
+      freenode = getfreetop(t, nodebase);
+      lj_assertL(freenode >= nodebase && freenode <= nodebase+t->hmask+1,
+		 "bad freenode");
+      do {
+	if (freenode == nodebase) {  /* No free node found? */
+	  rehashtab(L, t, key);  /* Rehash table. */
+	  return lj_tab_set(L, t, key);  /* Retry key insertion. */
+	}
+      } while (!tvisnil(&(--freenode)->key));
+      setfreetop(t, nodebase, freenode);
+    }
     lj_assertL(freenode != &G(L)->nilnode, "store to fallback hash");
     collide = hashkey(t, &n->key);
     if (collide != n) {  /* Colliding node not the main node? */
@@ -586,6 +630,107 @@ TValue *lj_tab_set(lua_State *L, GCtab *t, cTValue *key)
   return lj_tab_newkey(L, t, key);
 }
 
+/* -- Bulk operations ----------------------------------------------------- */
+
+/* Check whether a range of array slots can be accessed directly.
+** The destination array part is grown, if the range starts inside or
+** right after it. That's what appending element by element would do, too.
+*/
+static TValue *tab_rawrange(lua_State *L, GCtab *t, int32_t i, uint32_t n,
+			    int grow)
+{
+  uint32_t e = (uint32_t)i + n;  /* One past the last slot. */
+  if (i < 0 || (uint32_t)i > (t->asize ? t->asize : 1))
+    return NULL;
+  if (e > t->asize) {
+    if (!grow || e > LJ_MAX_ASIZE)
+      return NULL;
+    lj_tab_reasize(L, t, e-1);
+  }
+  return arrayslot(t, i);
+}
+
+/* Raw copy of a single element, which may rehash the destination table. */
+static void tab_rawmove1(lua_State *L, GCtab *src, int32_t i, GCtab *dst,
+			 int32_t j)
+{
+  cTValue *tv = lj_tab_getint(src, i);
+  if (tv && !tvisnil(tv)) {
+    TValue tmp;
+    copyTV(L, &tmp, tv);  /* The set may invalidate the get pointer. */
+    copyTV(L, lj_tab_setint(L, dst, j), &tmp);
+  } else if ((tv = lj_tab_getint(dst, j))) {
+    setnilV((TValue *)tv);  /* Don't create new keys for nil values. */
+  }
+}
+
+/* Raw move of src[f..e] to dst[t..]. Returns NULL if the range is too big
+** or the destination wraps around. The caller has to check for __index
+** and __newindex.
+*/
+GCtab *lj_tab_move(lua_State *L, GCtab *src, int32_t f, int32_t e,
+		   int32_t t, GCtab *dst)
+{
+  if (e >= f) {
+    uint32_t n = (uint32_t)((int64_t)e - f) + 1, k;
+    TValue *d, *s;
+    if ((int64_t)e - f >= INT32_MAX || (int64_t)t + n - 1 > INT32_MAX)
+      return NULL;
+    d = tab_rawrange(L, dst, t, n, 1);
+    s = tab_rawrange(L, src, f, n, 0);
+    if (d && s) {
+      memmove(d, s, n*sizeof(TValue));
+    } else if (t > e || t <= f || dst != src) {
+      for (k = 0; k < n; k++)
+	tab_rawmove1(L, src, f+(int32_t)k, dst, t+(int32_t)k);
+    } else {
+      for (k = n; k-- > 0; )
+	tab_rawmove1(L, src, f+(int32_t)k, dst, t+(int32_t)k);
+    }
+    lj_gc_anybarriert(L, dst);
+  }
+  return dst;
+}
+
+/* Raw store of v to t[i..e]. The caller has to check for __newindex. */
+void lj_tab_fill(lua_State *L, GCtab *t, int32_t i, int32_t e, cTValue *v)
+{
+  if (e >= i) {
+    uint32_t n = (uint32_t)((int64_t)e - i) + 1;
+    TValue *dst = tab_rawrange(L, t, i, n, !tvisnil(v));
+    if (dst) {
+      while (n--) copyTV(L, dst++, v);
+    } else if (!tvisnil(v)) {
+      do { copyTV(L, lj_tab_setint(L, t, i), v); } while (i++ < e);
+    } else {
+      do {
+	TValue *tv = (TValue *)lj_tab_getint(t, i);
+	if (tv) setnilV(tv);
+      } while (i++ < e);
+    }
+    lj_gc_anybarriert(L, t);
+  }
+}
+
+#if LJ_HASJIT
+/* Variants of lj_tab_fill() called from traces, which can't pass a TValue. */
+void lj_tab_fillnum(lua_State *L, GCtab *t, int32_t i, int32_t e,
+		    lua_Number n)
+{
+  TValue tv;
+  setnumV(&tv, n);
+  lj_tab_fill(L, t, i, e, &tv);
+}
+
+void lj_tab_fillpri(lua_State *L, GCtab *t, int32_t i, int32_t e,
+		    uint32_t irt)
+{
+  TValue tv;
+  setpriV(&tv, ~irt);  /* IRT_NIL/FALSE/TRUE are ~LJ_TNIL/FALSE/TRUE. */
+  lj_tab_fill(L, t, i, e, &tv);
+}
+#endif
+
 /* -- Table traversal ----------------------------------------------------- */
 
 /* Get the traversal index of a key. */
@@ -667,8 +812,8 @@ LJ_NOINLINE static MSize tab_len_slow(GCtab *t, size_t hi)
   return (MSize)lo;
 }
 
-/* Compute table length. Fast path. */
-MSize LJ_FASTCALL lj_tab_len(GCtab *t)
+/* Compute table length. Search the array part, then the hash part. */
+static MSize tab_len_search(GCtab *t)
 {
   size_t hi = (size_t)t->asize;
   if (hi) hi--;
@@ -686,6 +831,30 @@ MSize LJ_FASTCALL lj_tab_len(GCtab *t)
   return t->hmask ? tab_len_slow(t, hi) : (MSize)hi;
 }
 
+/* Compute table length. Fast path.
+**
+** The last result is kept in t->lenhint. It's not invalidated by stores,
+** but checked here: any n with t[n] ~= nil (or n == 0) and t[n+1] == nil
+** is a valid length. Checking n+1 and n-1, too, turns the length of a
+** table that's used as a stack (t[#t+1] = v, t[#t] = nil) into O(1).
+*/
+MSize LJ_FASTCALL lj_tab_len(GCtab *t)
+{
+  MSize n = t->lenhint;
+  cTValue *tv = lj_tab_getint(t, (int32_t)(n+1));
+  if (!tv || tvisnil(tv)) {  /* t[n+1] == nil */
+    if (n == 0 || ((tv = lj_tab_getint(t, (int32_t)n)) && !tvisnil(tv)))
+      return n;
+    if (n == 1 || ((tv = lj_tab_getint(t, (int32_t)(n-1))) && !tvisnil(tv)))
+      return (t->lenhint = n-1);
+  } else {  /* t[n+1] ~= nil */
+    tv = lj_tab_getint(t, (int32_t)(n+2));
+    if (!tv || tvisnil(tv))
+      return (t->lenhint = n+1);
+  }
+  return (t->lenhint = tab_len_search(t));
+}
+
 #if LJ_HASJIT
 /* Verify hinted table length or compute it. */
 MSize LJ_FASTCALL lj_tab_len_hint(GCtab *t, size_t hint)
@@ -693,9 +862,10 @@ MSize LJ_FASTCALL lj_tab_len_hint(GCtab *t, size_t hint)
   size_t asize = (size_t)t->asize;
   cTValue *tv = arrayslot(t, hint);
   if (LJ_LIKELY(hint+1 < asize)) {
-    if (LJ_LIKELY(!tvisnil(tv) && tvisnil(tv+1))) return (MSize)hint;
+    if (LJ_LIKELY(!tvisnil(tv) && tvisnil(tv+1)))
+      return (t->lenhint = (MSize)hint);
   } else if (hint+1 <= asize && LJ_LIKELY(t->hmask == 0) && !tvisnil(tv)) {
-    return (MSize)hint;
+    return (t->lenhint = (MSize)hint);
   }
   return lj_tab_len(t);
 }
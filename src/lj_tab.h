@@ -60,6 +60,17 @@ LJ_FUNCA TValue *lj_tab_setinth(lua_State *L, GCtab *t, int32_t key);
 LJ_FUNC TValue *lj_tab_setstr(lua_State *L, GCtab *t, GCstr *key);
 LJ_FUNC TValue *lj_tab_set(lua_State *L, GCtab *t, cTValue *key);
 
+LJ_FUNC GCtab *lj_tab_move(lua_State *L, GCtab *src, int32_t f, int32_t e,
+			   int32_t t, GCtab *dst);
+LJ_FUNC void lj_tab_fill(lua_State *L, GCtab *t, int32_t i, int32_t e,
+			 cTValue *v);
+#if LJ_HASJIT
+LJ_FUNC void lj_tab_fillnum(lua_State *L, GCtab *t, int32_t i, int32_t e,
+			    lua_Number n);
+LJ_FUNC void lj_tab_fillpri(lua_State *L, GCtab *t, int32_t i, int32_t e,
+			    uint32_t irt);
+#endif
+
 #define inarray(t, key)		((MSize)(key) < (MSize)(t)->asize)
 #define arrayslot(t, i)		(&tvref((t)->array)[(i)])
 #define lj_tab_getint(t, key) \
@@ -67,6 +78,16 @@ LJ_FUNC TValue *lj_tab_set(lua_State *L, GCtab *t, cTValue *key);
 #define lj_tab_setint(L, t, key) \
   (inarray((t), (key)) ? arrayslot((t), (key)) : lj_tab_setinth(L, (t), (key)))
 
+/* Typed array created by table.typed(). Elements follow the header. */
+typedef struct TypedArray {
+  MSize len;		/* Number of elements. */
+  MSize unused;		/* Keep the elements 8 byte aligned. */
+} TypedArray;
+
+#define tarr_data(ta)		((uint8_t *)((ta)+1))
+/* Element sizes 8, 4, 1, 1. ORDER TARR. */
+#define tarr_esize(udtype)	((0x1148u >> 4*((udtype)-UDTYPE_TARR_F64)) & 15u)
+
 LJ_FUNCA int lj_tab_next(lua_State *L, GCtab *t, TValue *key);
 LJ_FUNCA MSize LJ_FASTCALL lj_tab_len(GCtab *t);
 #if LJ_HASJIT
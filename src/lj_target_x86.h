@@ -301,6 +301,19 @@ typedef enum {
   XO_ADDSS =	XO_f30f(58),
   XO_MOVD =	XO_660f(6e),
   XO_MOVDto =	XO_660f(7e),
+  XO_MOVUPS =	XO_0f(10),
+  XO_MOVUPSto =	XO_0f(11),
+  XO_UNPCKLPD =	XO_660f(14),
+  XO_ADDPD =	XO_660f(58),
+  XO_SUBPD =	XO_660f(5c),
+  XO_MULPD =	XO_660f(59),
+  XO_DIVPD =	XO_660f(5e),
+  XO_PSHUFD =	XO_660f(70),
+  XO_PADDD =	XO_660f(fe),
+  XO_PSUBD =	XO_660f(fa),
+  XO_PAND =	XO_660f(db),
+  XO_POR =	XO_660f(eb),
+  XO_PXOR =	XO_660f(ef),
 
   XO_FLDd =	XO_(d9), XOg_FLDd = 0,
   XO_FLDq =	XO_(dd), XOg_FLDq = 0,
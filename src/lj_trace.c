@@ -3,6 +3,8 @@
 ** Copyright (C) 2005-2020 Mike Pall. See Copyright Notice in luajit.h
 */
 
+#include <time.h>
+
 #define lj_trace_c
 #define LUA_CORE
 
@@ -272,8 +274,12 @@ void lj_trace_flush(jit_State *J, TraceNo traceno)
 /* Flush all traces associated with a prototype. */
 void lj_trace_flushproto(global_State *g, GCproto *pt)
 {
+  jit_State *J = G2J(g);
+  const BCIns *pc = mref(J->reoptpc, const BCIns);
   while (pt->trace != 0)
-    trace_flushroot(G2J(g), traceref(G2J(g), pt->trace));
+    trace_flushroot(J, traceref(J, pt->trace));
+  if (pc >= proto_bc(pt) && pc < proto_bc(pt) + pt->sizebc)
+    setmref(J->reoptpc, NULL);  /* Drop pending re-recording. */
 }
 
 /* Flush all traces. */
@@ -295,6 +301,7 @@ int lj_trace_flushall(lua_State *L)
   }
   J->cur.traceno = 0;
   J->freetrace = 0;
+  setmref(J->reoptpc, NULL);
   /* Clear penalty cache. */
   memset(J->penalty, 0, sizeof(J->penalty));
   /* Free the whole machine code and invalidate all exit stub groups. */
@@ -364,8 +371,187 @@ void lj_trace_freestate(global_State *g)
   lj_mcode_free(J);
   lj_mem_freevec(g, J->snapmapbuf, J->sizesnapmap, SnapEntry);
   lj_mem_freevec(g, J->snapbuf, J->sizesnap, SnapShot);
+  lj_mem_freevec(g, J->usebuf, J->sizeuse, IRRef1);
   lj_mem_freevec(g, J->irbuf + J->irbotlim, J->irtoplim - J->irbotlim, IRIns);
   lj_mem_freevec(g, J->trace, J->sizetrace, GCRef);
+  if (J->warm)
+    lj_mem_freevec(g, J->warm, J->warmmask+1, TraceWarm);
+  lj_mem_freevec(g, J->warmpc, J->sizewarmpc, const BCIns *);
+}
+
+/* -- Warm start hints ---------------------------------------------------- */
+
+/* Hash bytes (FNV-1a). */
+static uint32_t warm_hash(uint32_t h, const uint8_t *p, MSize len)
+{
+  while (len--) h = (h ^ *p++) * 16777619u;
+  return h;
+}
+
+/* Map patched bytecodes back to their original opcode. */
+static BCOp warm_op(BCOp op)
+{
+  switch (op) {
+  case BC_JFORI: return BC_FORI;
+  case BC_IFORL: case BC_JFORL: return BC_FORL;
+  case BC_IITERL: case BC_JITERL: return BC_ITERL;
+  case BC_ILOOP: case BC_JLOOP: return BC_LOOP;
+  case BC_IFUNCF: case BC_JFUNCF: return BC_FUNCF;
+  case BC_IFUNCV: case BC_JFUNCV: return BC_FUNCV;
+  case BC_ITERN: return BC_ITERC;  /* May be despecialized. */
+  case BC_ISNEXT: return BC_JMP;
+  default: return op;
+  }
+}
+
+/* Compute the identity of a prototype, which survives process restarts.
+** Only opcodes and A operands are hashed, since the D operand of patched
+** bytecodes holds a trace number.
+*/
+void lj_trace_warmkey(GCproto *pt, TraceWarm *w)
+{
+  GCstr *name = proto_chunkname(pt);
+  uint32_t h = 2166136261u;
+  BCPos i;
+  for (i = 0; i < pt->sizebc; i++) {
+    BCIns ins = proto_bc(pt)[i];
+    uint8_t b[2];
+    b[0] = (uint8_t)warm_op(bc_op(ins));
+    b[1] = (uint8_t)bc_a(ins);
+    h = warm_hash(h, b, 2);
+  }
+  w->chunkhash = warm_hash(2166136261u, (const uint8_t *)strdata(name),
+			   name->len);
+  w->bchash = h;
+  w->firstline = pt->firstline;
+  w->pos = 0;
+}
+
+#define WARM_EMPTY		(~(BCPos)0)	/* Free hash slot. */
+#define warm_hashkey(w) \
+  ((w)->chunkhash ^ (w)->bchash ^ (uint32_t)(w)->firstline*0x9e3779b1u)
+#define warm_slot(pc)		(U64x(0,1) << ((u32ptr((pc)+1)>>2) & (HOTCOUNT_SIZE-1)))
+
+/* Replace the warm start hints with an empty hash table for n hints. */
+void lj_trace_warmreset(lua_State *L, MSize n)
+{
+  jit_State *J = L2J(L);
+  MSize i, sz = 0;
+  if (J->warm) {
+    lj_mem_freevec(G(L), J->warm, J->warmmask+1, TraceWarm);
+    J->warm = NULL;
+    J->warmmask = 0;
+    J->nwarm = 0;
+  }
+  if (n == 0)
+    return;
+  for (sz = 4; sz < 2*n; sz += sz) ;  /* Keep the load factor below 0.5. */
+  J->warm = lj_mem_newvec(L, sz, TraceWarm);
+  J->warmmask = sz-1;
+  for (i = 0; i < sz; i++)
+    J->warm[i].pos = WARM_EMPTY;
+}
+
+/* Add a warm start hint. The hash table must have room for it. */
+void lj_trace_warmadd(jit_State *J, const TraceWarm *w)
+{
+  MSize i = warm_hashkey(w) & J->warmmask;
+  lj_assertJ(J->nwarm < J->warmmask, "warm start hash table full");
+  if (w->pos == WARM_EMPTY)
+    return;
+  while (J->warm[i].pos != WARM_EMPTY)
+    i = (i+1) & J->warmmask;
+  J->warm[i] = *w;
+  J->nwarm++;
+}
+
+/* Binary search for a hinted start PC. Returns its index or where to
+** insert it.
+*/
+static MSize warm_findpc(jit_State *J, const BCIns *pc)
+{
+  MSize lo = 0, hi = J->nwarmpc;
+  while (lo < hi) {
+    MSize mid = (lo+hi) >> 1;
+    if (J->warmpc[mid] < pc) lo = mid+1; else hi = mid;
+  }
+  return lo;
+}
+
+/* Remove hinted start PCs from index k to k+n-1. */
+static void warm_delpc(jit_State *J, MSize k, MSize n)
+{
+  J->nwarmpc -= n;
+  memmove(J->warmpc+k, J->warmpc+k+n, (J->nwarmpc-k)*sizeof(const BCIns *));
+}
+
+/* Record the warm start hints for a newly loaded prototype and its
+** children. The hinted start PCs are kept in a sorted vector. Each one
+** arms its hotcount slot, so the slot fires the next time it's counted.
+** The hint itself is only applied by lj_trace_hot() for that PC.
+*/
+void lj_trace_warm(lua_State *L, GCproto *pt)
+{
+  jit_State *J = L2J(L);
+  TraceWarm key;
+  MSize i;
+  lj_trace_warmkey(pt, &key);
+  for (i = warm_hashkey(&key) & J->warmmask; J->warm[i].pos != WARM_EMPTY;
+       i = (i+1) & J->warmmask) {
+    TraceWarm *w = &J->warm[i];
+    if (w->chunkhash == key.chunkhash && w->bchash == key.bchash &&
+	w->firstline == key.firstline && w->pos < pt->sizebc) {
+      const BCIns *pc = proto_bc(pt) + w->pos;
+      MSize k = warm_findpc(J, pc);
+      if (k == J->nwarmpc || J->warmpc[k] != pc) {
+	if (J->nwarmpc == J->sizewarmpc)
+	  lj_mem_growvec(L, J->warmpc, J->sizewarmpc, LJ_MAX_MEM32,
+			 const BCIns *);
+	memmove(J->warmpc+k+1, J->warmpc+k,
+		(J->nwarmpc-k)*sizeof(const BCIns *));
+	J->warmpc[k] = pc;
+	J->nwarmpc++;
+	hotcount_set(J2GG(J), pc+1, 1);
+	J->warmarmed |= warm_slot(pc);
+      }
+    }
+  }
+  if ((pt->flags & PROTO_CHILD)) {
+    ptrdiff_t j, n = pt->sizekgc;
+    GCRef *kr = mref(pt->k, GCRef) - 1;
+    for (j = 0; j < n; j++, kr--) {
+      GCobj *o = gcref(*kr);
+      if (o->gch.gct == ~LJ_TPROTO)
+	lj_trace_warm(L, gco2pt(o));
+    }
+  }
+}
+
+/* Drop the hinted start PCs of a prototype that is about to be freed. */
+void lj_trace_warmfree(global_State *g, GCproto *pt)
+{
+  jit_State *J = G2J(g);
+  MSize k = warm_findpc(J, proto_bc(pt)), e = k;
+  while (e < J->nwarmpc && J->warmpc[e] < proto_bc(pt) + pt->sizebc)
+    e++;
+  if (e > k)
+    warm_delpc(J, k, e-k);
+}
+
+/* Check a hotcount event against the hinted start PCs. Returns 0 if the
+** slot only fired early because it was armed for a different PC.
+*/
+static int trace_warmhot(jit_State *J, const BCIns *pc)
+{
+  uint64_t slot = warm_slot(pc);
+  int armed = (J->warmarmed & slot) != 0;
+  MSize k = warm_findpc(J, pc);
+  J->warmarmed &= ~slot;
+  if (k < J->nwarmpc && J->warmpc[k] == pc) {
+    warm_delpc(J, k, 1);  /* Hint used up. */
+    return 1;
+  }
+  return !armed;
 }
 
 /* -- Penalties and blacklisting ------------------------------------------ */
@@ -402,6 +588,37 @@ setpenalty:
   hotcount_set(J2GG(J), pc+1, val);
 }
 
+/* -- Compile time budget ------------------------------------------------- */
+
+/* CPU time of the current thread in usec. Wraps around, only differences
+** are used. Falls back to process CPU time without a per-thread clock.
+*/
+static uint32_t trace_usec(void)
+{
+#if LJ_TARGET_POSIX && defined(CLOCK_THREAD_CPUTIME_ID)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+#endif
+  return (uint32_t)((uint64_t)clock() * 1000000 / CLOCKS_PER_SEC);
+}
+
+/* Check whether the compile time budget allows starting a new trace.
+** Bounds the time spent compiling bursts of new traces in any window of
+** one second of CPU time to the burstmsec parameter.
+*/
+static int trace_burst_check(jit_State *J)
+{
+  uint32_t now = trace_usec();
+  if (now - J->burstclock >= 1000000) {  /* Start a new window. */
+    J->burstclock = now;
+    J->burstused = 0;
+  }
+  if (J->burstused >= (uint32_t)J->param[JIT_P_burstmsec]*1000)
+    return 0;  /* Budget exhausted. The hotcount or exit will retrigger. */
+  return 1;
+}
+
 /* -- Trace compiler state machine ---------------------------------------- */
 
 /* Start tracing. */
@@ -423,6 +640,11 @@ static void trace_start(jit_State *J)
     return;
   }
 
+  if (J->param[JIT_P_burstmsec] && !trace_burst_check(J)) {
+    J->state = LJ_TRACE_IDLE;  /* Over compile time budget, try again later. */
+    return;
+  }
+
   /* Get a new trace number. */
   traceno = trace_findfree(J);
   if (LJ_UNLIKELY(traceno == 0)) {  /* No free trace? */
@@ -488,6 +710,10 @@ static void trace_stop(jit_State *J)
   case BC_LOOP:
   case BC_ITERL:
   case BC_FUNCF:
+    if (pc == mref(J->reoptpc, BCIns)) {  /* Re-recorded loop? */
+      J->cur.reopted = 1;
+      setmref(J->reoptpc, NULL);
+    }
     /* Patch bytecode of starting instruction in root trace. */
     setbc_op(pc, (int)op+(int)BC_JLOOP-(int)BC_LOOP);
     setbc_d(pc, traceno);
@@ -727,6 +953,14 @@ void lj_trace_ins(jit_State *J, const BCIns *pc)
   J->pc = pc;
   J->fn = curr_func(J->L);
   J->pt = isluafunc(J->fn) ? funcproto(J->fn) : NULL;
+  if (J->param[JIT_P_burstmsec]) {
+    /* Only charge the recorder and compiler, not the interpreter. */
+    uint32_t start = trace_usec();
+    while (lj_vm_cpcall(J->L, NULL, (void *)J, trace_state) != 0)
+      J->state = LJ_TRACE_ERR;
+    J->burstused += trace_usec() - start;
+    return;
+  }
   while (lj_vm_cpcall(J->L, NULL, (void *)J, trace_state) != 0)
     J->state = LJ_TRACE_ERR;
 }
@@ -740,7 +974,8 @@ void LJ_FASTCALL lj_trace_hot(jit_State *J, const BCIns *pc)
   hotcount_set(J2GG(J), pc, J->param[JIT_P_hotloop]*HOTCOUNT_LOOP);
   /* Only start a new trace if not recording or inside __gc call or vmevent. */
   if (J->state == LJ_TRACE_IDLE &&
-      !(J2G(J)->hookmask & (HOOK_GC|HOOK_VMEVENT))) {
+      !(J2G(J)->hookmask & (HOOK_GC|HOOK_VMEVENT)) &&
+      (LJ_LIKELY(!J->nwarmpc) || trace_warmhot(J, pc-1))) {
     J->parent = 0;  /* Root trace. */
     J->exitno = 0;
     J->state = LJ_TRACE_START;
@@ -749,15 +984,47 @@ void LJ_FASTCALL lj_trace_hot(jit_State *J, const BCIns *pc)
   ERRNO_RESTORE
 }
 
+/* Check whether a hot exit should re-record its root trace.
+**
+** After an exit from a looping root trace, the next iteration re-enters
+** the trace at its start. If an exit from this first, unrolled iteration
+** becomes hot, consecutive iterations leave the recorded path, i.e. the
+** control flow has flipped since the trace was recorded. A side trace
+** would then run on every iteration and re-enter the root trace through
+** the same failing guard. So flush the root trace together with its side
+** traces and let the loop be recorded again along the current path.
+** The new root trace is flagged to prevent doing this repeatedly for
+** the same loop.
+*/
+static int trace_reopt(jit_State *J, GCtrace *T, SnapShot *snap)
+{
+  BCIns *startpc = mref(T->startpc, BCIns);
+  IRRef ref;
+  if (T->root != 0 || T->link != T->traceno || T->reopted)
+    return 0;  /* Only once for exits from looping root traces. */
+  for (ref = T->nins-1; ref > REF_FIRST; ref--)
+    if (T->ir[ref].o == IR_LOOP) break;
+  if (snap->ref >= ref)
+    return 0;  /* Exit from the loop body or no loop. */
+  if (++T->hotloopexits < (uint32_t)J->param[JIT_P_reoptthreshold])
+    return 0;
+  lj_trace_flush(J, T->traceno);
+  setmref(J->reoptpc, startpc);
+  return 1;
+}
+
 /* Check for a hot side exit. If yes, start recording a side trace. */
 static void trace_hotside(jit_State *J, const BCIns *pc)
 {
-  SnapShot *snap = &traceref(J, J->parent)->snap[J->exitno];
+  GCtrace *T = traceref(J, J->parent);
+  SnapShot *snap = &T->snap[J->exitno];
   if (!(J2G(J)->hookmask & (HOOK_GC|HOOK_VMEVENT)) &&
       isluafunc(curr_func(J->L)) &&
       snap->count != SNAPCOUNT_DONE &&
       ++snap->count >= J->param[JIT_P_hotexit]) {
     lj_assertJ(J->state == LJ_TRACE_IDLE, "hot side exit while recording");
+    if (J->param[JIT_P_reopt] && trace_reopt(J, T, snap))
+      return;
     /* J->parent is non-zero for a side trace. */
     J->state = LJ_TRACE_START;
     lj_trace_ins(J, pc);
@@ -32,6 +32,13 @@ LJ_FUNC int lj_trace_flushall(lua_State *L);
 LJ_FUNC void lj_trace_initstate(global_State *g);
 LJ_FUNC void lj_trace_freestate(global_State *g);
 
+/* Warm start hints. */
+LJ_FUNC void lj_trace_warmkey(GCproto *pt, TraceWarm *w);
+LJ_FUNC void lj_trace_warmreset(lua_State *L, MSize n);
+LJ_FUNC void lj_trace_warmadd(jit_State *J, const TraceWarm *w);
+LJ_FUNC void lj_trace_warm(lua_State *L, GCproto *pt);
+LJ_FUNC void lj_trace_warmfree(global_State *g, GCproto *pt);
+
 /* Event handling. */
 LJ_FUNC void lj_trace_ins(jit_State *J, const BCIns *pc);
 LJ_FUNCA void LJ_FASTCALL lj_trace_hot(jit_State *J, const BCIns *pc);